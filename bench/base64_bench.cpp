@@ -0,0 +1,86 @@
+// base64解码吞吐量测试
+// 对比原版base64_decode 和base64_try_decode的标量实现/SIMD实现
+// 用法: base64_bench [数据大小MB，默认16]
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <fmt/core.h>
+#include "base64.h"
+
+namespace {
+
+// 重复运行fn 返回每秒处理的输入MB数(取最好的一次)
+template <typename Fn>
+double measure(const std::string& input, Fn fn) {
+    double best = 0;
+    for (int round = 0; round < 5; round++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+        best = std::max(best, input.size() / seconds / (1024.0 * 1024.0));
+    }
+    return best;
+}
+
+void run(const std::string& name, const std::string& input, const std::string& expected,
+         bool hasLinebreaks) {
+    std::string out;
+
+    double original = measure(input, [&]() { out = base64_decode(input, hasLinebreaks); });
+    bool originalOk = out == expected;
+
+    base64_force_scalar(true);
+    double scalar = measure(input, [&]() { base64_try_decode(input, out); });
+    bool scalarOk = out == expected;
+
+    base64_force_scalar(false);
+    double fast = measure(input, [&]() { base64_try_decode(input, out); });
+    bool fastOk = out == expected;
+
+    fmt::print("{:<12} {:>10.1f} {:>10.1f} {:>10.1f}   {}\n", name, original, scalar, fast,
+               (originalOk && scalarOk && fastOk) ? "ok" : "MISMATCH");
+}
+
+// 和base64_encode_mime的输出一样 每76个字符插一个换行
+// base64_encode_mime每插一次都要挪动后面的全部内容 16MB要跑好几分钟 这里一遍拼出来
+std::string wrapLines(const std::string& encoded, size_t lineLength) {
+    std::string wrapped;
+    wrapped.reserve(encoded.size() + encoded.size() / lineLength);
+    for (size_t pos = 0; pos < encoded.size(); pos += lineLength) {
+        if (pos > 0) {
+            wrapped.push_back('\n');
+        }
+        wrapped.append(encoded, pos, lineLength);
+    }
+    return wrapped;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+    if (megabytes == 0) {
+        megabytes = 16;
+    }
+
+    // 解码后的原始数据
+    std::mt19937 rng(42);
+    std::string raw(megabytes * 1024 * 1024 / 4 * 3, '\0');
+    for (auto& c : raw) {
+        c = static_cast<char>(rng() & 0xff);
+    }
+
+    std::string plain = base64_encode(raw);
+    std::string url = base64_encode(raw, true);
+    std::string mime = wrapLines(plain, 76);
+
+    fmt::print("数据大小: {} MB  SIMD实现: {}\n", megabytes, base64_decode_impl());
+    fmt::print("{:<12} {:>10} {:>10} {:>10}   (MB/s)\n", "输入", "原版", "标量", "自动选择");
+    run("标准", plain, raw, false);
+    run("url安全", url, raw, false);
+    run("带换行", mime, raw, true);
+    return 0;
+}
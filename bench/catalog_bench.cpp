@@ -0,0 +1,131 @@
+// 节点目录和SQLite的启动开销对比
+// 在临时目录里生成一个有N个节点的数据库和节点目录
+// 然后分别测"打开 + 按id查当前节点 + 读第一页 + 搜索"要多久
+// 用法: catalog_bench [节点数，默认100000]
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+#include "DatabaseManager.h"
+#include "NodeCatalog.h"
+#include "NodeRecord.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// 重复运行fn 返回最好的一次用了多少微秒
+template <typename Fn>
+double measure(Fn fn) {
+    double best = 1e18;
+    for (int round = 0; round < 5; round++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::micro>(end - start).count());
+    }
+    return best;
+}
+
+// 启动时要做的事: 按id查当前节点 读第一页 返回读到的行数
+template <typename Visit>
+size_t startup(Visit visit, int currentId) {
+    size_t rows = 0;
+    auto count = [&rows](const NodeRow&) {
+        rows++;
+        return true;
+    };
+
+    NodeFilter current;
+    current.id = currentId;
+    visit(current, "", count);
+
+    NodeFilter page;
+    page.canonicalOnly = true;
+    page.limit = 21;
+    visit(page, "", count);
+    return rows;
+}
+
+// 搜一页 返回读到的行数
+template <typename Visit>
+size_t search(Visit visit, const std::string& query) {
+    size_t rows = 0;
+    NodeFilter page;
+    page.canonicalOnly = true;
+    page.limit = 21;
+    visit(page, query, [&rows](const NodeRow&) {
+        rows++;
+        return true;
+    });
+    return rows;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int total = argc > 1 ? std::atoi(argv[1]) : 100000;
+    fs::path dir = fs::temp_directory_path() / "heresy_catalog_bench";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    std::string dbPath = (dir / "bench.db").string();
+
+    {
+        DatabaseManager db(dbPath);
+        if (!db.open() || !db.addSubscribe(Subscribe(0, "bench", "http://localhost/"))) {
+            fmt::print("无法创建测试数据库\n");
+            return 1;
+        }
+        std::vector<NodeRecord> nodes;
+        nodes.reserve(total);
+        for (int i = 0; i < total; i++) {
+            nodes.push_back(TrojanNode("pass", fmt::format("h{}.example.com", i), 443, fmt::format("node-{}", i),
+                                       fmt::format("h{}.example.com", i), "tcp"));
+        }
+        if (!db.addNodes(nodes, 1) || !db.writeCatalog()) {
+            fmt::print("无法写入测试数据\n");
+            return 1;
+        }
+    }
+
+    int currentId = total / 2;
+    std::string catalogPath = DatabaseManager(dbPath).getCatalogPath();
+    fmt::print("节点数 {}  目录文件 {:.1f}KB\n", total, fs::file_size(catalogPath) / 1024.0);
+    fmt::print("{:<10} {:>14} {:>14} {:>14}\n", "", "启动(us)", "搜索3字(us)", "搜索罕见词(us)");
+
+    // 每一项都从打开开始算 和进程刚启动时一样
+    auto viaSqlite = [&dbPath](auto work) {
+        DatabaseManager db(dbPath);
+        db.open();
+        return work([&db](const NodeFilter& filter, const std::string& query, const auto& fn) {
+            if (query.empty()) {
+                db.forEachNode(filter, NodeProjection::Summary, fn);
+            } else {
+                db.searchNodes(query, filter, fn);
+            }
+        });
+    };
+    auto viaCatalog = [&catalogPath](auto work) {
+        NodeCatalog reader(catalogPath);
+        reader.refresh();
+        return work([&reader](const NodeFilter& filter, const std::string& query, const auto& fn) {
+            reader.forEachNode(filter, query, fn);
+        });
+    };
+
+    auto report = [&](const char* name, auto via) {
+        size_t rows[3] = {};
+        double startupTime = measure([&]() { rows[0] = via([&](auto visit) { return startup(visit, currentId); }); });
+        double commonTime = measure([&]() { rows[1] = via([](auto visit) { return search(visit, "node"); }); });
+        double rareTime = measure([&]() { rows[2] = via([](auto visit) { return search(visit, "node-99999"); }); });
+        fmt::print("{:<10} {:>14.0f} {:>14.0f} {:>14.0f}   {}/{}/{}行\n", name, startupTime, commonTime, rareTime,
+                   rows[0], rows[1], rows[2]);
+    };
+    report("sqlite", viaSqlite);
+    report("catalog", viaCatalog);
+
+    fs::remove_all(dir);
+    return 0;
+}
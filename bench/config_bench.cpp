@@ -0,0 +1,112 @@
+// 生成有很多出站的Xray配置要多久
+// 以前每个节点先生成自己的JSON 再dump(4)成字符串 ConfigManager再parse回来
+// 现在节点直接写进outbounds数组里的一项 最后整个配置序列化一次
+// 分别测两种生成方式 和缩进/不缩进两种输出格式
+// 用法: config_bench [出站数，默认10000]
+#include <chrono>
+#include <iomanip>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+#include <nlohmann/json.hpp>
+#include "NodeParserRegistry.h"
+#include "NodeRecord.h"
+#include "ProtocolTraits.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+// 重复运行fn 返回最好的一次用了多少毫秒
+template <typename Fn>
+double measure(Fn fn) {
+    double best = 1e18;
+    for (int round = 0; round < 5; round++) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+// hysteria2节点生成配置时会写hy2_config.yaml 这里不用
+std::string makeLink(int i) {
+    std::string addr = fmt::format("node{}.example.net", i);
+    int port = 20000 + i % 3000;
+    switch (i % 3) {
+        case 0:
+            return fmt::format("vless://{:08x}-1111-4222-8333-444455556666@{}:{}?encryption=none&flow=xtls-rprx-vision"
+                               "&security=reality&sni=www.apple.com&fp=chrome&pbk={:043}&sid=0a1b&type=tcp#vless{}",
+                               i, addr, port, i % 50, i);
+        case 1:
+            return fmt::format("trojan://pass{}@{}:{}?sni={}&type=grpc&serviceName=svc#trojan{}", i % 50, addr, port,
+                               addr, i);
+        default:
+            return fmt::format("vless://{:08x}-1111-4222-8333-444455556666@{}:{}?encryption=none&security=tls"
+                               "&sni={}&type=ws&path=/ray&host={}#ws{}",
+                               i, addr, port, addr, addr, i);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int total = argc > 1 ? std::atoi(argv[1]) : 10000;
+
+    std::vector<NodeRecord> nodes;
+    nodes.reserve(total);
+    for (int i = 0; i < total; i++) {
+        std::optional<NodeRecord> node = NodeParserRegistry::instance().parse(makeLink(i));
+        if (node) {
+            nodes.push_back(std::move(*node));
+        }
+    }
+
+    // 以前的做法: 每个节点dump(4)成字符串再parse回来
+    json roundTrip;
+    double roundTripMs = measure([&]() {
+        roundTrip = json::array();
+        for (const NodeRecord& node : nodes) {
+            json outbound;
+            outboundFromNode(node, outbound);
+            roundTrip.push_back(json::parse(outbound.dump(4)));
+        }
+    });
+
+    // 现在的做法: 直接写进数组里新加的一项
+    json direct;
+    double directMs = measure([&]() {
+        direct = json::array();
+        for (const NodeRecord& node : nodes) {
+            outboundFromNode(node, direct.emplace_back());
+        }
+    });
+
+    std::string pretty;
+    double dumpMs = measure([&]() { pretty = direct.dump(4); });
+
+    size_t prettySize = 0;
+    double prettyMs = measure([&]() {
+        std::ostringstream out;
+        out << std::setw(4) << direct;
+        prettySize = out.tellp();
+    });
+
+    size_t compactSize = 0;
+    double compactMs = measure([&]() {
+        std::ostringstream out;
+        out << direct;
+        compactSize = out.tellp();
+    });
+
+    fmt::print("出站数 {}  两种方式结果{}\n", nodes.size(), roundTrip == direct ? "一致" : "不一致!");
+    fmt::print("生成出站 dump(4)+parse往返 {:.2f}ms  直接写进配置树 {:.2f}ms  快{:.1f}倍\n", roundTripMs, directMs,
+               roundTripMs / directMs);
+    fmt::print("整体输出 dump(4)成字符串 {:.2f}ms\n", dumpMs);
+    fmt::print("整体输出 缩进写进流 {:.2f}ms {:.1f}KB  不缩进 {:.2f}ms {:.1f}KB\n", prettyMs, prettySize / 1024.0,
+               compactMs, compactSize / 1024.0);
+    return 0;
+}
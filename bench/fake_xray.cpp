@@ -0,0 +1,200 @@
+// 测切换节点用的假Xray 只模拟切换时用到的那一点行为 不转发任何流量
+// 编出来的文件名就叫xray 和真的一样按pid文件认得回来
+//   xray -c 配置文件              读出出站的标签 在API入站的端口上等命令 一直运行到被杀掉
+//                                 别的入站端口也监听 连上就断开 用来判断启动好了没有
+//   xray api rmo --server=地址 标签...  删除出站 标签不存在时失败
+//   xray api ado --server=地址 文件...  添加文件里的出站 标签已经存在时失败
+// API是一行一条命令的文本协议 不是真的gRPC 只用来量进程启动和往返的开销
+// 启动时先睡FAKE_XRAY_STARTUP_MS毫秒(默认200) 模拟真Xray加载geoip/geosite的时间
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+namespace {
+
+bool readJson(const std::string& path, json& out) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    out = json::parse(file, nullptr, false);
+    return !out.is_discarded();
+}
+
+// 读一行 不含换行符 连接断开时返回false
+bool readLine(int fd, std::string& line) {
+    line.clear();
+    char c;
+    while (read(fd, &c, 1) == 1) {
+        if (c == '\n') {
+            return true;
+        }
+        line += c;
+    }
+    return false;
+}
+
+bool writeLine(int fd, const std::string& line) {
+    std::string data = line + "\n";
+    return write(fd, data.data(), data.size()) == static_cast<ssize_t>(data.size());
+}
+
+// 在本机port端口上监听 失败返回-1
+int listenOn(int port) {
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(server, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(server, 16) != 0) {
+        close(server);
+        return -1;
+    }
+    return server;
+}
+
+int runCore(const std::string& configPath) {
+    json config;
+    if (!readJson(configPath, config)) {
+        return 1;
+    }
+
+    std::set<std::string> tags;
+    for (const auto& outbound : config.value("outbounds", json::array())) {
+        tags.insert(outbound.value("tag", ""));
+    }
+    int port = 0;
+    std::vector<int> otherPorts;
+    for (const auto& inbound : config.value("inbounds", json::array())) {
+        if (inbound.value("tag", "") == "api-in") {
+            port = inbound.value("port", 0);
+        } else {
+            otherPorts.push_back(inbound.value("port", 0));
+        }
+    }
+    if (port == 0) {
+        return 1;
+    }
+
+    const char* startup = std::getenv("FAKE_XRAY_STARTUP_MS");
+    std::this_thread::sleep_for(std::chrono::milliseconds(startup ? std::atoi(startup) : 200));
+
+    int server = listenOn(port);
+    if (server < 0) {
+        return 1;
+    }
+    for (int other : otherPorts) {
+        int fd = listenOn(other);
+        if (fd < 0) {
+            return 1;
+        }
+        std::thread([fd]() {
+            while (true) {
+                int client = accept(fd, nullptr, nullptr);
+                if (client >= 0) {
+                    close(client);
+                }
+            }
+        }).detach();
+    }
+
+    while (true) {
+        int client = accept(server, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        std::string line;
+        while (readLine(client, line)) {
+            size_t space = line.find(' ');
+            std::string command = line.substr(0, space);
+            std::string tag = space == std::string::npos ? "" : line.substr(space + 1);
+            bool ok = false;
+            if (command == "rmo") {
+                ok = tags.erase(tag) > 0;
+            } else if (command == "ado") {
+                ok = tags.insert(tag).second;
+            }
+            writeLine(client, ok ? "ok" : "fail");
+        }
+        close(client);
+    }
+}
+
+// 把每条命令发给--server指定的地址 全部成功返回0
+int runApi(const std::string& server, const std::vector<std::string>& commands) {
+    size_t colon = server.rfind(':');
+    if (colon == std::string::npos) {
+        return 1;
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(std::atoi(server.c_str() + colon + 1)));
+    if (inet_pton(AF_INET, server.substr(0, colon).c_str(), &addr.sin_addr) != 1) {
+        return 1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return 1;
+    }
+    int result = 0;
+    std::string reply;
+    for (const auto& command : commands) {
+        if (!writeLine(fd, command) || !readLine(fd, reply) || reply != "ok") {
+            result = 1;
+            break;
+        }
+    }
+    close(fd);
+    return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    if (args.size() == 2 && args[0] == "-c") {
+        return runCore(args[1]);
+    }
+
+    if (args.size() >= 3 && args[0] == "api") {
+        std::string server = "127.0.0.1:8080";
+        std::vector<std::string> commands;
+        for (size_t i = 2; i < args.size(); i++) {
+            if (args[i].rfind("--server=", 0) == 0) {
+                server = args[i].substr(std::strlen("--server="));
+            } else if (args[1] == "rmo") {
+                commands.push_back("rmo " + args[i]);
+            } else if (args[1] == "ado") {
+                json file;
+                if (!readJson(args[i], file)) {
+                    return 1;
+                }
+                for (const auto& outbound : file.value("outbounds", json::array())) {
+                    commands.push_back("ado " + outbound.value("tag", ""));
+                }
+            } else {
+                return 1;
+            }
+        }
+        return runApi(server, commands);
+    }
+
+    return 1;
+}
@@ -0,0 +1,146 @@
+// 节点占用内存测试
+// 生成N条像真实订阅一样的分享链接(同一个机场的节点共用uuid/密码 pbk sni等参数)
+// 解析成std::vector<NodeRecord> 统计解析前后堆内存的差值 算出平均每个节点多少字节
+// 节点的内存布局改动前后各跑一次 对比每个节点的字节数和分配次数
+// 用法: node_memory_bench [节点数，默认100000]
+#include <malloc.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+#include "InternedString.h"
+#include "NodeParserRegistry.h"
+#include "NodeRecord.h"
+#include "base64.h"
+
+namespace {
+
+// 当前还没释放的堆内存 按malloc实际给的块大小算
+std::atomic<size_t> liveBytes{0};
+// 一共分配过多少次
+std::atomic<size_t> allocations{0};
+
+void* allocate(size_t size) {
+    void* p = std::malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    liveBytes.fetch_add(malloc_usable_size(p), std::memory_order_relaxed);
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return p;
+}
+
+void release(void* p) {
+    if (p) {
+        liveBytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+        std::free(p);
+    }
+}
+
+const char* const kRegions[] = {"🇭🇰 香港", "🇯🇵 日本", "🇸🇬 新加坡", "🇺🇸 美国", "🇹🇼 台湾"};
+const char* const kRegionCodes[] = {"hk", "jp", "sg", "us", "tw"};
+const char* const kSnis[] = {"www.microsoft.com", "www.apple.com", "addons.mozilla.org"};
+
+// 每个机场200个节点 同一个机场的凭据和传输参数相同
+const int kNodesPerAirport = 200;
+
+std::string fakeUuid(int seed) {
+    return fmt::format("{:08x}-{:04x}-4{:03x}-8{:03x}-{:012x}", seed * 2654435761u, seed & 0xffff,
+                       seed & 0xfff, (seed * 7) & 0xfff, static_cast<uint64_t>(seed) * 0x9e3779b97f4aULL);
+}
+
+std::string makeLink(int i) {
+    int airport = i / kNodesPerAirport;
+    int region = i % 5;
+    std::string uuid = fakeUuid(airport + 1);
+    std::string addr = fmt::format("{}{:02}.airport{}.net", kRegionCodes[region], i % 100, airport);
+    std::string info = fmt::format("{} {:02} | IPLC 1.5x", kRegions[region], i % 100);
+    int port = 20000 + i % 3000;
+
+    switch (i % 20) {
+        case 0: case 1: case 2: case 3: case 4: case 5: case 6: case 7: {
+            // vless reality
+            std::string pbk = fmt::format("{:043}", airport);
+            return fmt::format("vless://{}@{}:{}?encryption=none&flow=xtls-rprx-vision&security=reality"
+                               "&sni={}&fp=chrome&pbk={}&sid={:08x}&type=tcp#{}",
+                               uuid, addr, port, kSnis[airport % 3], pbk, airport, info);
+        }
+        case 8: case 9: case 10: case 11: {
+            // vmess ws tls
+            std::string json = fmt::format(
+                R"({{"v":"2","ps":"{}","add":"{}","port":"{}","id":"{}","aid":"0","scy":"auto",)"
+                R"("net":"ws","type":"none","host":"{}","path":"/ray{}","tls":"tls","sni":"{}"}})",
+                info, addr, port, uuid, addr, airport, addr);
+            return "vmess://" + base64_encode(json);
+        }
+        case 12: case 13: case 14: case 15: case 16:
+            return fmt::format("trojan://{}@{}:{}?sni={}&type=tcp#{}", fmt::format("pass{:028}", airport), addr,
+                               port, addr, info);
+        default:
+            return fmt::format("hysteria2://{}@{}:{}?sni={}&obfs=salamander&obfs-password=obfs{}&insecure=0#{}",
+                               fmt::format("hy2pass{:025}", airport), addr, port, addr, airport, info);
+    }
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+    return allocate(size);
+}
+
+void* operator new[](size_t size) {
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p) noexcept {
+    release(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    release(p);
+}
+
+int main(int argc, char** argv) {
+    int total = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    std::vector<std::string> links;
+    links.reserve(total);
+    for (int i = 0; i < total; i++) {
+        links.push_back(makeLink(i));
+    }
+    // 注册表的单例先创建好 不算进节点里
+    NodeParserRegistry& registry = NodeParserRegistry::instance();
+
+    size_t before = liveBytes.load();
+    size_t allocationsBefore = allocations.load();
+    std::vector<NodeRecord> nodes;
+    nodes.reserve(total);
+    for (const std::string& link : links) {
+        std::optional<NodeRecord> node = registry.parse(link);
+        if (node) {
+            nodes.push_back(std::move(*node));
+        }
+    }
+    size_t used = liveBytes.load() - before;
+    size_t parseAllocations = allocations.load() - allocationsBefore;
+
+    fmt::print("节点数 {}  解析成功 {}\n", total, nodes.size());
+    fmt::print("sizeof(NodeRecord) {} 字节\n", sizeof(NodeRecord));
+    fmt::print("堆内存 {:.1f}MB  平均每个节点 {:.0f} 字节\n", used / (1024.0 * 1024.0),
+               nodes.empty() ? 0.0 : static_cast<double>(used) / nodes.size());
+    fmt::print("解析时分配内存 {} 次  平均每个节点 {:.1f} 次\n", parseAllocations,
+               nodes.empty() ? 0.0 : static_cast<double>(parseAllocations) / nodes.size());
+    fmt::print("驻留池 {} 个字符串 {:.1f}KB(已经算在上面的堆内存里)\n", InternedString::poolSize(),
+               InternedString::poolBytes() / 1024.0);
+    return 0;
+}
@@ -0,0 +1,129 @@
+// 切换节点要多久 用fake_xray.cpp编出来的假Xray代替真的
+// 通过API换出站: switchNode 两个节点来回切
+// 重启: 写配置文件 + restartXray 以前每次切换都要这样(或者更糟 手动停了再启动)
+// 重启的时间主要是假Xray的启动时间(FAKE_XRAY_STARTUP_MS) 等端口能连上就返回 不再固定睡
+// 用法: switch_bench [API切换次数，默认20] [重启次数，默认3]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fmt/core.h>
+#include "ConfigManager.h"
+#include "NodeParserRegistry.h"
+#include "process_util.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Timing {
+    double total = 0;
+    double worst = 0;
+    int count = 0;
+
+    void add(double ms) {
+        total += ms;
+        worst = std::max(worst, ms);
+        count++;
+    }
+};
+
+template <typename Fn>
+double elapsedMs(Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void report(const char* name, const Timing& timing) {
+    fmt::print("{} {}次  平均 {:.1f}ms  最慢 {:.1f}ms\n", name, timing.count,
+               timing.count ? timing.total / timing.count : 0.0, timing.worst);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int apiRounds = argc > 1 ? std::atoi(argv[1]) : 20;
+    int restartRounds = argc > 2 ? std::atoi(argv[2]) : 3;
+    const std::string xrayPath = FAKE_XRAY_PATH;
+
+    // startXray会打开~/.heresy下的数据库 换一个临时的HOME
+    fs::path home = fs::temp_directory_path() / "heresy_switch_bench";
+    fs::remove_all(home);
+    fs::create_directories(home);
+    setenv("HOME", home.c_str(), 1);
+    ConfigManager configManager((home / ".heresy/").string());
+
+    // 假Xray要用socks和API入站的端口
+    if (localPortOpen(10808) || localPortOpen(10085)) {
+        fmt::print("10808或10085端口已经有程序在监听(可能是Xray) 先停掉它再测\n");
+        return 1;
+    }
+
+    std::vector<NodeRecord> nodes;
+    for (const char* link : {
+             "vless://11111111-2222-3333-4444-555555555555@a.example.com:443?security=tls&type=ws&path=/ws#A",
+             "trojan://pass@b.example.com:443?sni=b.example.com&type=tcp#B",
+         }) {
+        std::optional<NodeRecord> node = NodeParserRegistry::instance().parse(link);
+        if (!node) {
+            return 1;
+        }
+        node->node().setId(static_cast<int>(nodes.size()) + 1);
+        nodes.push_back(std::move(*node));
+    }
+
+    // ConfigManager每一步都会打印 测的时候不要
+    std::ostringstream discard;
+    std::streambuf* console = std::cout.rdbuf(discard.rdbuf());
+
+    configManager.generateXrayConfig(nodes[0]);
+    if (!configManager.startXray(xrayPath)) {
+        std::cout.rdbuf(console);
+        fmt::print("假Xray没能启动: {}\n", xrayPath);
+        return 1;
+    }
+
+    Timing api;
+    int apiFailures = 0;
+    for (int i = 0; i < apiRounds; i++) {
+        const NodeRecord& node = nodes[(i + 1) % nodes.size()];
+        SwitchResult result = SwitchResult::Failed;
+        api.add(elapsedMs([&]() { result = configManager.switchNode(node, xrayPath); }));
+        if (result != SwitchResult::Api) {
+            apiFailures++;
+        }
+    }
+
+    Timing restart;
+    int restartFailures = 0;
+    for (int i = 0; i < restartRounds; i++) {
+        const NodeRecord& node = nodes[i % nodes.size()];
+        bool ok = false;
+        restart.add(elapsedMs([&]() {
+            ok = configManager.generateXrayConfig(node) && configManager.restartXray(xrayPath);
+        }));
+        if (!ok) {
+            restartFailures++;
+        }
+    }
+
+    configManager.stopXray();
+    std::cout.rdbuf(console);
+    fs::remove_all(home);
+
+    report("通过API切换", api);
+    if (apiFailures > 0) {
+        fmt::print("  其中{}次没能走API\n", apiFailures);
+    }
+    report("写配置+重启", restart);
+    if (restartFailures > 0) {
+        fmt::print("  其中{}次重启失败\n", restartFailures);
+    }
+    return 0;
+}
@@ -4,6 +4,8 @@
 #include <cstdlib>
 #include <chrono>
 #include <thread>
+#include <algorithm>
+#include <cctype>
 #include <fmt/core.h>
 #include <fmt/color.h>
 #include "VlessNode.h"
@@ -15,15 +17,11 @@
 #include <windows.h>
 #endif
 
-CLI::CLI() : currentNodeId(-1) {
+CLI::CLI() : databaseOpened(false), currentNodeId(-1) {
+    // 数据库等第一次用到时再打开 只看节点的话有节点目录就够了
     dbManager = std::make_unique<DatabaseManager>();
     configManager = std::make_unique<ConfigManager>();
-    
-    // 打开数据库连接
-    if (!dbManager->open()) {
-        fmt::print(fg(fmt::color::red), "无法打开数据库，程序将退出\n");
-        exit(1);
-    }
+    catalog = std::make_unique<NodeCatalog>(dbManager->getCatalogPath());
     
 #ifdef _WIN32
     // 在Windows平台上设置控制台为UTF-8编码
@@ -32,6 +30,18 @@ CLI::CLI() : currentNodeId(-1) {
 #endif
 }
 
+DatabaseManager& CLI::database() {
+    if (!databaseOpened) {
+        // 打开数据库连接
+        if (!dbManager->open()) {
+            fmt::print(fg(fmt::color::red), "无法打开数据库，程序将退出\n");
+            exit(1);
+        }
+        databaseOpened = true;
+    }
+    return *dbManager;
+}
+
 void CLI::run() {
     while (true) {
         showMainMenu();
@@ -68,14 +78,26 @@ void CLI::showMainMenu() {
     // 显示当前状态
     fmt::print(fg(fmt::color::yellow), "\n当前状态：\n");
     
+    // 只需要别名 不用把整个节点读出来
+    std::string currentInfo;
+    bool found = false;
     if (currentNodeId > 0) {
-        Node* node = dbManager->getNodeById(currentNodeId);
-        if (node) {
-            fmt::print("当前节点: {}\n", node->getInfo());
-            delete node;
+        NodeFilter filter;
+        filter.id = currentNodeId;
+        auto take = [&](const NodeRow& row) {
+            currentInfo = std::string(row.info);
+            found = true;
+            return false;
+        };
+        if (catalog->refresh()) {
+            catalog->forEachNode(filter, "", take);
         } else {
-            fmt::print("当前节点: 未选择\n");
+            database().forEachNode(filter, NodeProjection::Summary, take);
         }
+    }
+    
+    if (found) {
+        fmt::print("当前节点: {}\n", currentInfo);
     } else {
         fmt::print("当前节点: 未选择\n");
     }
@@ -91,6 +113,7 @@ void CLI::showSubscribeMenu() {
         fmt::print("3. 更新订阅\n");
         fmt::print("4. 删除订阅\n");
         fmt::print("5. 编辑订阅\n");
+        fmt::print("6. 更新全部订阅\n");
         fmt::print("0. 返回主菜单\n");
         
         int choice = getUserInputNumber("请选择操作：");
@@ -111,6 +134,9 @@ void CLI::showSubscribeMenu() {
             case 5:
                 editSubscribe();
                 break;
+            case 6:
+                updateAllSubscribes();
+                break;
             case 0:
                 return;
             default:
@@ -126,6 +152,8 @@ void CLI::showNodeMenu() {
         fmt::print("1. 列出所有节点\n");
         fmt::print("2. 选择节点\n");
         fmt::print("3. 测试节点延迟\n");
+        fmt::print("4. 搜索节点\n");
+        fmt::print("5. 负载均衡(多个节点)\n");
         fmt::print("0. 返回主菜单\n");
         
         int choice = getUserInputNumber("请选择操作：");
@@ -140,6 +168,12 @@ void CLI::showNodeMenu() {
             case 3:
                 testNodeLatency();
                 break;
+            case 4:
+                searchNodes();
+                break;
+            case 5:
+                balanceNodes();
+                break;
             case 0:
                 return;
             default:
@@ -198,14 +232,14 @@ void CLI::addSubscribe() {
     }
     
     Subscribe subscribe(-1, name, url);
-    if (dbManager->addSubscribe(subscribe)) {
+    if (database().addSubscribe(subscribe)) {
         fmt::print(fg(fmt::color::green), "添加订阅成功\n");
         
         // 询问是否立即更新订阅
         std::string choice = getUserInput("是否立即更新订阅？(y/n)：");
         if (choice == "y" || choice == "Y") {
             // 获取刚添加的订阅ID
-            auto subscribes = dbManager->getAllSubscribes();
+            auto subscribes = database().getAllSubscribes();
             for (const auto& s : subscribes) {
                 if (s.getName() == name && s.getUrl() == url) {
                     SubscribeManager::update(s);
@@ -219,7 +253,7 @@ void CLI::addSubscribe() {
 }
 
 void CLI::listSubscribes() {
-    auto subscribes = dbManager->getAllSubscribes();
+    auto subscribes = database().getAllSubscribes();
     
     if (subscribes.empty()) {
         fmt::print(fg(fmt::color::yellow), "没有找到任何订阅\n");
@@ -227,12 +261,15 @@ void CLI::listSubscribes() {
     }
     
     fmt::print(fg(fmt::color::cyan), "\n===== 订阅列表 =====\n");
-    fmt::print("{:<5} {:<20} {}\n", "ID", "名称", "链接");
+    fmt::print("{:<5} {:<20} {:<8} {}\n", "ID", "名称", "节点数", "链接");
     
     for (const auto& subscribe : subscribes) {
-        fmt::print("{:<5} {:<20} {}\n", 
+        NodeFilter filter;
+        filter.subscribeId = subscribe.getId();
+        fmt::print("{:<5} {:<20} {:<8} {}\n", 
                  subscribe.getId(), 
                  subscribe.getName(), 
+                 database().countNodes(filter),
                  subscribe.getUrl());
     }
 }
@@ -246,7 +283,7 @@ void CLI::updateSubscribe() {
         return;
     }
     
-    Subscribe subscribe = dbManager->getSubscribeById(id);
+    Subscribe subscribe = database().getSubscribeById(id);
     
     if (subscribe.getId() == 0) {
         fmt::print(fg(fmt::color::red), "未找到该订阅\n");
@@ -258,6 +295,16 @@ void CLI::updateSubscribe() {
     fmt::print(fg(fmt::color::green), "更新订阅完成\n");
 }
 
+void CLI::updateAllSubscribes() {
+    if (database().isTableEmpty("subscribes")) {
+        fmt::print(fg(fmt::color::yellow), "没有找到任何订阅\n");
+        return;
+    }
+    
+    SubscribeManager::updateAll();
+    fmt::print(fg(fmt::color::green), "全部订阅更新完成\n");
+}
+
 void CLI::deleteSubscribe() {
     listSubscribes();
     
@@ -267,8 +314,9 @@ void CLI::deleteSubscribe() {
         return;
     }
     
-    if (dbManager->deleteSubscribe(id)) {
+    if (database().deleteSubscribe(id)) {
         fmt::print(fg(fmt::color::green), "删除订阅成功\n");
+        database().refreshCatalog();
     } else {
         fmt::print(fg(fmt::color::red), "删除订阅失败\n");
     }
@@ -283,7 +331,7 @@ void CLI::editSubscribe() {
         return;
     }
     
-    Subscribe subscribe = dbManager->getSubscribeById(id);
+    Subscribe subscribe = database().getSubscribeById(id);
     
     if (subscribe.getId() == 0) {
         fmt::print(fg(fmt::color::red), "未找到该订阅\n");
@@ -302,7 +350,7 @@ void CLI::editSubscribe() {
         subscribe.setUrl(newUrl);
     }
     
-    if (dbManager->updateSubscribe(subscribe)) {
+    if (database().updateSubscribe(subscribe)) {
         fmt::print(fg(fmt::color::green), "更新订阅完成\n");
     } else {
         fmt::print(fg(fmt::color::red), "更新订阅失败\n");
@@ -310,83 +358,296 @@ void CLI::editSubscribe() {
 }
 
 void CLI::listNodes() {
-    auto nodes = dbManager->getAllNodes();
+    browseNodes("节点列表", NodeFilter(), "", false);
+}
+
+void CLI::searchNodes() {
+    std::string query = getUserInput("请输入关键词(多个词用空格分开)：");
+    std::string protocol = getUserInput("请输入协议(直接回车不限)：");
     
-    if (nodes.empty()) {
-        fmt::print(fg(fmt::color::yellow), "没有找到任何节点\n");
-        return;
+    NodeFilter filter;
+    filter.protocol = protocol;
+    browseNodes("搜索结果", filter, query, false);
+}
+
+int CLI::browseNodes(const std::string& title, const NodeFilter& filter, const std::string& query, bool selectable) {
+    // 多个订阅里重复的服务器只列出一次 选择和测速都只针对不重复的节点
+    NodeFilter base = filter;
+    base.canonicalOnly = true;
+    base.afterId = 0;
+    base.beforeId = 0;
+    // 多读一行 用来判断后面还有没有
+    base.limit = kNodePageSize + 1;
+    
+    std::string keyword = query;
+    NodeFilter page = base;
+    while (true) {
+        std::vector<NodeListItem> items = fetchNodePage(page, keyword);
+        bool backwards = page.beforeId > 0;
+        bool more = items.size() > static_cast<size_t>(kNodePageSize);
+        if (more) {
+            items.pop_back();
+        }
+        if (backwards) {
+            // 往前翻到头了 不满一页的话直接显示第一页
+            if (!more) {
+                page = base;
+                continue;
+            }
+            std::reverse(items.begin(), items.end());
+        }
+        bool hasPrev = backwards ? more : page.afterId > 0;
+        bool hasNext = backwards ? true : more;
+        
+        if (items.empty()) {
+            fmt::print(fg(fmt::color::yellow), keyword.empty() ? "没有找到任何节点\n" : "没有找到匹配的节点\n");
+        } else {
+            printNodeHeader(keyword.empty() ? title : title + " - " + keyword);
+            for (const auto& item : items) {
+                printNodeRow(item);
+            }
+        }
+        
+        std::string hint = "0 返回";
+        if (hasNext) {
+            hint += "  n 下一页";
+        }
+        if (hasPrev) {
+            hint += "  p 上一页";
+        }
+        hint += "  g ID 跳到该ID  f 关键词 筛选(只输入f取消筛选)";
+        if (selectable) {
+            hint += "  直接输入ID 选择节点";
+        }
+        fmt::print(fg(fmt::color::yellow), "{}\n", hint);
+        
+        std::string input = getUserInput("请输入：");
+        if (!std::cin) {
+            return 0;
+        }
+        
+        if (input.empty() || input == "0" || input == "q") {
+            return 0;
+        } else if (input == "n") {
+            if (hasNext && !items.empty()) {
+                page = base;
+                page.afterId = items.back().id;
+            }
+        } else if (input == "p") {
+            if (hasPrev && !items.empty()) {
+                page = base;
+                page.beforeId = items.front().id;
+            }
+        } else if (input[0] == 'g') {
+            int id = std::atoi(input.c_str() + 1);
+            page = base;
+            page.afterId = std::max(0, id - 1);
+        } else if (input[0] == 'f') {
+            size_t begin = input.find_first_not_of(' ', 1);
+            keyword = begin == std::string::npos ? "" : input.substr(begin);
+            page = base;
+        } else if (selectable && std::isdigit(static_cast<unsigned char>(input[0]))) {
+            return std::atoi(input.c_str());
+        } else {
+            fmt::print(fg(fmt::color::red), "无效的输入，请重试\n");
+        }
     }
-    
-    fmt::print(fg(fmt::color::cyan), "\n===== 节点列表 =====\n");
+}
+
+std::vector<CLI::NodeListItem> CLI::fetchNodePage(const NodeFilter& filter, const std::string& query) {
+    std::vector<NodeListItem> items;
+    items.reserve(filter.limit > 0 ? filter.limit : 0);
+    auto collect = [&items](const NodeRow& row) {
+        items.push_back({row.id, std::string(row.protocol), std::string(row.addr), row.port, std::string(row.info)});
+        return true;
+    };
+    
+    if (catalog->refresh()) {
+        catalog->forEachNode(filter, query, collect);
+    } else if (query.empty()) {
+        database().forEachNode(filter, NodeProjection::Summary, collect);
+    } else {
+        database().searchNodes(query, filter, collect);
+    }
+    return items;
+}
+
+void CLI::printNodeHeader(const std::string& title) {
+    fmt::print(fg(fmt::color::cyan), "\n===== {} =====\n", title);
     fmt::print("{:<5} {:<15} {:<25} {:<10} {:<5} {:<15}\n", "ID", "协议", "地址", "端口", "状态", "别名");
-    
-    for (const auto& node : nodes) {
-        std::string status = (node->getId() == currentNodeId) ? "当前" : "";
-        fmt::print("{:<5} {:<15} {:<25} {:<10} {:<5} {:<15}\n", 
-                 node->getId(), node->getProtocol(), node->getAddr(), 
-                 node->getPort(), status, node->getInfo());
+}
+
+void CLI::printNodeRow(const NodeListItem& item) {
+    std::string_view status = (item.id == currentNodeId) ? "当前" : "";
+    fmt::print("{:<5} {:<15} {:<25} {:<10} {:<5} {:<15}\n", 
+             item.id, item.protocol, item.addr, 
+             item.port, status, item.info);
+}
+
+int CLI::search(const std::vector<std::string>& args) {
+    NodeFilter filter;
+    std::string query;
+    for (size_t i = 0; i < args.size(); i++) {
+        const std::string& arg = args[i];
+        bool hasValue = i + 1 < args.size();
+        if (arg == "--protocol" && hasValue) {
+            filter.protocol = args[++i];
+        } else if (arg == "--security" && hasValue) {
+            filter.security = args[++i];
+        } else if (arg == "--limit" && hasValue) {
+            filter.limit = std::atoi(args[++i].c_str());
+        } else {
+            if (!query.empty()) {
+                query += ' ';
+            }
+            query += arg;
+        }
     }
     
-    // 释放内存
-    for (auto node : nodes) {
-        delete node;
+    // 输出给脚本用 一行一个节点 用制表符分隔
+    int count = 0;
+    auto print = [&](const NodeRow& row) {
+        fmt::print("{}\t{}\t{}\t{}\t{}\n", row.id, row.protocol, row.addr, row.port, row.info);
+        count++;
+        return true;
+    };
+    bool ok = catalog->refresh() ? catalog->forEachNode(filter, query, print)
+                                 : database().searchNodes(query, filter, print);
+    
+    if (!ok) {
+        return 1;
     }
+    return count > 0 ? 0 : 2;
 }
 
 void CLI::selectNode() {
-    listNodes();
-    
-    int id = getUserInputNumber("请输入要选择的节点ID（0取消）：");
+    int id = browseNodes("选择节点", NodeFilter(), "", true);
     
     if (id == 0) {
         return;
     }
     
-    Node* node = dbManager->getNodeById(id);
+    std::optional<NodeRecord> node = database().getNodeById(id);
     
     if (!node) {
         fmt::print(fg(fmt::color::red), "未找到该节点\n");
         return;
     }
     
-    // 生成配置文件
-    if (configManager->generateXrayConfig(node)) {
-        fmt::print(fg(fmt::color::green), "已生成配置文件\n");
-        currentNodeId = id;
+    // 生成配置文件 Xray在运行时顺便切过去
+    switch (configManager->switchNode(*node)) {
+        case SwitchResult::Written:
+            fmt::print(fg(fmt::color::green), "已生成配置文件\n");
+            currentNodeId = id;
+            break;
+        case SwitchResult::Api:
+            fmt::print(fg(fmt::color::green), "已切换节点 Xray没有重启\n");
+            currentNodeId = id;
+            break;
+        case SwitchResult::Restarted:
+            fmt::print(fg(fmt::color::green), "已切换节点 Xray重启了一次\n");
+            currentNodeId = id;
+            break;
+        case SwitchResult::Failed:
+            fmt::print(fg(fmt::color::red), "切换节点失败\n");
+            break;
+    }
+}
+
+void CLI::balanceNodes() {
+    std::string subscribeId = getUserInput("请输入订阅ID(直接回车不限)：");
+    std::string protocol = getUserInput("请输入协议(直接回车不限)：");
+    std::string query = getUserInput("请输入关键词(直接回车不限)：");
+    std::string limit = getUserInput("最多用几个节点(直接回车不限)：");
+    
+    // 重复的服务器只用一次
+    NodeFilter filter;
+    filter.subscribeId = std::atoi(subscribeId.c_str());
+    filter.protocol = protocol;
+    filter.canonicalOnly = true;
+    filter.limit = std::atoi(limit.c_str());
+    
+    std::vector<NodeRecord> nodes;
+    if (query.empty()) {
+        nodes = database().getNodes(filter);
     } else {
+        // 搜索只返回摘要 按id再读出完整的节点
+        std::vector<int> ids;
+        database().searchNodes(query, filter, [&ids](const NodeRow& row) {
+            ids.push_back(row.id);
+            return true;
+        });
+        for (int id : ids) {
+            std::optional<NodeRecord> node = database().getNodeById(id);
+            if (node) {
+                nodes.push_back(std::move(*node));
+            }
+        }
+    }
+    
+    if (nodes.empty()) {
+        fmt::print(fg(fmt::color::yellow), "没有找到符合条件的节点\n");
+        return;
+    }
+    fmt::print("找到{}个节点\n", nodes.size());
+    
+    BalancerOptions options;
+    fmt::print("1. 延迟最低(leastPing)\n");
+    fmt::print("2. 负载最低(leastLoad)\n");
+    std::string strategy = getUserInput("请选择策略(直接回车选1)：");
+    if (strategy == "2") {
+        options.strategy = BalancerStrategy::LeastLoad;
+    }
+    std::string probeUrl = getUserInput(fmt::format("测延迟的地址(直接回车用{})：", options.probeUrl));
+    if (!probeUrl.empty()) {
+        options.probeUrl = probeUrl;
+    }
+    std::string interval = getUserInput(fmt::format("多久测一次(直接回车用{})：", options.probeInterval));
+    if (!interval.empty()) {
+        options.probeInterval = interval;
+    }
+    
+    if (!configManager->generateBalancedConfig(nodes, options)) {
         fmt::print(fg(fmt::color::red), "生成配置文件失败\n");
+        return;
     }
+    // 不再是某一个节点
+    currentNodeId = 0;
     
-    delete node;
+    // 负载均衡改了路由和observatory API换不了 正在运行的Xray要重启才会读新的配置文件
+    if (!configManager->isXrayRunning()) {
+        fmt::print(fg(fmt::color::green), "已生成负载均衡配置文件 启动代理后生效\n");
+    } else if (configManager->restartXray()) {
+        fmt::print(fg(fmt::color::green), "已切换到负载均衡 Xray重启了一次\n");
+    } else {
+        fmt::print(fg(fmt::color::red), "已生成负载均衡配置文件 但Xray没能重新启动\n");
+    }
 }
 
 void CLI::testNodeLatency() {
-    listNodes();
-    
-    int id = getUserInputNumber("请输入要测试的节点ID（0取消）：");
+    int id = browseNodes("测试节点延迟", NodeFilter(), "", true);
     
     if (id == 0) {
         return;
     }
     
-    Node* node = dbManager->getNodeById(id);
+    std::optional<NodeRecord> node = database().getNodeById(id);
     
     if (!node) {
         fmt::print(fg(fmt::color::red), "未找到该节点\n");
         return;
     }
     
-    fmt::print("正在测试节点 {} 的延迟...\n", node->getInfo());
+    fmt::print("正在测试节点 {} 的延迟...\n", node->node().getInfo());
     
     // 简单的ping测试
-    std::string command = "ping -c 3 " + node->getAddr();
+    std::string command = "ping -c 3 " + std::string(node->node().getAddr());
     
 #ifdef _WIN32
-    command = "ping -n 3 " + node->getAddr();
+    command = "ping -n 3 " + std::string(node->node().getAddr());
 #endif
     
     system(command.c_str());
-    delete node;
 }
 
 void CLI::startProxy() {
@@ -7,11 +7,18 @@
 #include "DatabaseManager.h"
 #include "ConfigManager.h"
 #include "SubscribeManager.h"
+#include "NodeCatalog.h"
 
 class CLI {
 private:
     std::unique_ptr<DatabaseManager> dbManager;
     std::unique_ptr<ConfigManager> configManager;
+    // 节点目录 存在时列表和搜索直接读它
+    std::unique_ptr<NodeCatalog> catalog;
+    bool databaseOpened;
+    
+    // 第一次调用时才打开数据库 打不开就退出程序
+    DatabaseManager& database();
     
     // 当前选中的节点ID
     int currentNodeId;
@@ -37,6 +44,9 @@ private:
     // 更新订阅
     void updateSubscribe();
     
+    // 并发更新全部订阅
+    void updateAllSubscribes();
+    
     // 删除订阅
     void deleteSubscribe();
     
@@ -46,12 +56,42 @@ private:
     // 列出所有节点
     void listNodes();
     
+    // 按关键词搜索节点
+    void searchNodes();
+    
+    // 节点列表里的一行 从数据库读出来后复制一份 翻页时只保存当前这一页
+    struct NodeListItem {
+        int id;
+        std::string protocol;
+        std::string addr;
+        int port;
+        std::string info;
+    };
+    
+    // 每页显示多少个节点
+    static const int kNodePageSize = 20;
+    
+    // 分页浏览节点 每次只从数据库读出一页 可以翻页 跳到某个ID 按关键词筛选
+    // filter是固定的过滤条件 query是初始的关键词
+    // selectable为true时可以输入ID选择节点 返回选中的ID 没有选择时返回0
+    int browseNodes(const std::string& title, const NodeFilter& filter, const std::string& query, bool selectable);
+    
+    // 按filter里的分页条件读出一页节点 query非空时按关键词搜索
+    std::vector<NodeListItem> fetchNodePage(const NodeFilter& filter, const std::string& query);
+    
+    // 节点表格的表头和一行
+    void printNodeHeader(const std::string& title);
+    void printNodeRow(const NodeListItem& item);
+    
     // 选择节点
     void selectNode();
     
     // 测试节点延迟
     void testNodeLatency();
     
+    // 用一组节点生成负载均衡的配置
+    void balanceNodes();
+    
     // 启动代理
     void startProxy();
     
@@ -72,6 +112,10 @@ public:
     
     // 运行CLI界面
     void run();
+    
+    // 非交互的搜索 heresy search [--protocol 协议] [--security 安全类型] [--limit 数量] 关键词...
+    // args是search后面的参数 返回进程退出码
+    int search(const std::vector<std::string>& args);
 };
 
 #endif 
@@ -5,21 +5,14 @@
 #include <string>
 #include <thread>
 #include <chrono>
-#include "VlessNode.h"
-#include "VmessNode.h"
-#include "TrojanNode.h"
-#include "Hy2Node.h"
 #include "DatabaseManager.h"
+#include "NodeCatalog.h"
+#include "ProtocolTraits.h"
+#include "process_util.h"
 
 #ifdef _WIN32
 #include <windows.h>
 #include <tlhelp32.h>
-#else
-#include <unistd.h>
-#include <signal.h>
-#include <sys/types.h>
-#include <dirent.h>
-#include <cstring>
 #endif
 
 namespace fs = std::filesystem;
@@ -44,13 +37,25 @@ ConfigManager::ConfigManager(const std::string& configDir) {
     }
     
     this->xrayConfigPath = this->configDir + "xray_config.json";
+    
+#ifndef _WIN32
+    // 上次运行留下的进程按pid文件认回来
+    xray = std::make_unique<ProcessSupervisor>("xray", this->configDir + "xray.pid");
+    hysteria = std::make_unique<ProcessSupervisor>("hysteria", this->configDir + "hysteria.pid");
+#endif
 }
 
 json ConfigManager::defaultRoutingRules() {
     // 这里可以根据需要自定义路由规则
+    // 第一条把API入站交给Xray自己的API 不能被后面的规则抢走
     json routing = {
         {"domainStrategy", "IPIfNonMatch"},
         {"rules", json::array({
+            {
+                {"type", "field"},
+                {"inboundTag", json::array({"api-in"})},
+                {"outboundTag", "api"}
+            },
             {
                 {"type", "field"},
                 {"outboundTag", "direct"},
@@ -85,7 +90,7 @@ json ConfigManager::defaultInbounds() {
     json inbounds = json::array({
         {
             {"tag", "socks-in"},
-            {"port", 10808},
+            {"port", kSocksPort},
             {"listen", "127.0.0.1"},
             {"protocol", "socks"},
             {"settings", {
@@ -112,91 +117,122 @@ json ConfigManager::defaultInbounds() {
                 {"enabled", true},
                 {"destOverride", json::array({"http", "tls"})}
             }}
+        },
+        {
+            // Xray的API 只监听本机 切换节点时用它换出站
+            {"tag", "api-in"},
+            {"port", kApiPort},
+            {"listen", "127.0.0.1"},
+            {"protocol", "dokodemo-door"},
+            {"settings", {
+                {"address", "127.0.0.1"}
+            }}
         }
     });
     
     return inbounds;
 }
 
-json ConfigManager::generateOutbound(const Node* node) {
-    if (node->getProtocol() == "vless") {
-        const VlessNode* vlessNode = static_cast<const VlessNode*>(node);
-        // 转换为JSON，获取配置片段
-        std::string configStr = vlessNode->toXrayConfig();
-        json outbound = json::parse(configStr);
-        return outbound;
-    } else if (node->getProtocol() == "vmess") {
-        const VmessNode* vmessNode = static_cast<const VmessNode*>(node);
-        // 转换为JSON，获取配置片段
-        std::string configStr = vmessNode->toXrayConfig();
-        json outbound = json::parse(configStr);
-        return outbound;
-    } else if (node->getProtocol() == "trojan") {
-        const TrojanNode* trojanNode = static_cast<const TrojanNode*>(node);
-        // 转换为JSON，获取配置片段
-        std::string configStr = trojanNode->toXrayConfig();
-        json outbound = json::parse(configStr);
-        return outbound;
-    } else if (node->getProtocol() == "hy2") {
-        const Hy2Node* hy2Node = static_cast<const Hy2Node*>(node);
-        // 转换为JSON，获取配置片段
-        std::string configStr = hy2Node->toXrayConfig();
-        json outbound = json::parse(configStr);
-        return outbound;
-    } else {
-        // 默认情况，创建一个通用的出站配置
-        json outbound = {
-            {"protocol", node->getProtocol()},
-            {"settings", {}},
-            {"tag", "proxy"}
-        };
-        return outbound;
-    }
+void ConfigManager::generateOutbound(const NodeRecord& node, json& outbound) {
+    // 各协议的出站配置见ProtocolTraits的outbound
+    outboundFromNode(node, outbound);
 }
 
-bool ConfigManager::generateXrayConfig(const Node* node) {
-    if (!node) {
-        std::cerr << "节点为空，无法生成配置" << std::endl;
+bool ConfigManager::writeConfig(const json& config, ConfigStyle style, const std::string& path) {
+    std::string tmpPath = path + ".tmp";
+    std::ofstream configFile(tmpPath);
+    if (!configFile.is_open()) {
+        std::cerr << "无法打开配置文件进行写入: " << tmpPath << std::endl;
         return false;
     }
     
+    // 直接序列化到文件流 不先dump成一整个字符串
+    // operator<<遇到非法UTF-8会抛异常 这里用的是同一个序列化器 只是把坏字节换成U+FFFD
     try {
-        // 创建基本配置
-        json config = {
-            {"log", {
-                {"loglevel", "warning"}
-            }},
-            {"inbounds", defaultInbounds()},
-            {"outbounds", json::array({
-                generateOutbound(node),
-                {
-                    {"protocol", "freedom"},
-                    {"tag", "direct"},
-                    {"settings", {}}
-                },
-                {
-                    {"protocol", "blackhole"},
-                    {"tag", "block"},
-                    {"settings", {}}
-                },
-                {
-                    {"protocol", "dns"},
-                    {"tag", "dns-out"}
-                }
-            })},
-            {"routing", defaultRoutingRules()}
-        };
+        bool pretty = style == ConfigStyle::Pretty;
+        nlohmann::detail::serializer<json> serializer(
+            nlohmann::detail::output_adapter<char>(configFile), ' ', json::error_handler_t::replace);
+        serializer.dump(config, pretty, false, pretty ? 4 : 0);
+        configFile.close();
+    } catch (const std::exception& e) {
+        std::cerr << "序列化配置失败: " << e.what() << std::endl;
+        configFile.close();
+        fs::remove(tmpPath);
+        return false;
+    }
+    
+    if (!configFile) {
+        std::cerr << "写入配置文件失败: " << tmpPath << std::endl;
+        fs::remove(tmpPath);
+        return false;
+    }
+    
+    // 同一个目录里改名是原子的 旧文件要么还在 要么已经整个换成新的
+    std::error_code ec;
+    fs::rename(tmpPath, path, ec);
+    if (ec) {
+        std::cerr << "替换配置文件失败: " << ec.message() << std::endl;
+        fs::remove(tmpPath);
+        return false;
+    }
+    return true;
+}
+
+bool ConfigManager::writeConfig(const json& config, ConfigStyle style) {
+    return writeConfig(config, style, xrayConfigPath);
+}
+
+json ConfigManager::baseConfig() {
+    return {
+        {"log", {
+            {"loglevel", "warning"}
+        }},
+        {"api", {
+            {"tag", "api"},
+            {"services", json::array({"HandlerService", "RoutingService"})}
+        }},
+        {"inbounds", defaultInbounds()},
+        {"outbounds", json::array()},
+        {"routing", defaultRoutingRules()}
+    };
+}
+
+void ConfigManager::appendBuiltinOutbounds(json& outbounds) {
+    outbounds.push_back({
+        {"protocol", "freedom"},
+        {"tag", "direct"},
+        {"settings", {}}
+    });
+    outbounds.push_back({
+        {"protocol", "blackhole"},
+        {"tag", "block"},
+        {"settings", {}}
+    });
+    outbounds.push_back({
+        {"protocol", "dns"},
+        {"tag", "dns-out"}
+    });
+}
+
+bool ConfigManager::generateXrayConfig(const NodeRecord& node, ConfigStyle style) {
+    try {
+        // 节点的出站放在第一个 没有路由规则匹配的流量都走它
+        json config = baseConfig();
+        json& outbounds = config["outbounds"];
+        generateOutbound(node, outbounds.emplace_back());
+        appendBuiltinOutbounds(outbounds);
+        // 其余流量按标签交给proxy 通过API换掉proxy出站后它不一定还在第一个
+        config["routing"]["rules"].push_back({
+            {"type", "field"},
+            {"network", "tcp,udp"},
+            {"outboundTag", "proxy"}
+        });
         
         // 写入配置文件
-        std::ofstream configFile(xrayConfigPath);
-        if (!configFile.is_open()) {
-            std::cerr << "无法打开配置文件进行写入: " << xrayConfigPath << std::endl;
+        if (!writeConfig(config, style)) {
             return false;
         }
         
-        configFile << config.dump(4);
-        configFile.close();
-        
         std::cout << "已生成配置文件: " << xrayConfigPath << std::endl;
         return true;
     } catch (const std::exception& e) {
@@ -205,6 +241,131 @@ bool ConfigManager::generateXrayConfig(const Node* node) {
     }
 }
 
+bool ConfigManager::generateBalancedConfig(const std::vector<NodeRecord>& nodes, const BalancerOptions& options,
+                                           ConfigStyle style) {
+    // 节点出站的标签都以它开头 负载均衡和observatory按前缀选出这些出站
+    const std::string tagPrefix = "proxy-";
+    const std::string balancerTag = "balancer";
+    
+    try {
+        json config = baseConfig();
+        json& outbounds = config["outbounds"];
+        int added = 0;
+        int skipped = 0;
+        for (const NodeRecord& node : nodes) {
+            // Hysteria2节点在Xray里只是转发到本地hysteria客户端的http出站 一次只能跑一个
+            if (node.get<Hy2Node>()) {
+                skipped++;
+                continue;
+            }
+            json& outbound = outbounds.emplace_back();
+            generateOutbound(node, outbound);
+            outbound["tag"] = tagPrefix + std::to_string(node.node().getId());
+            added++;
+        }
+        
+        if (skipped > 0) {
+            std::cout << "跳过了" << skipped << "个Hysteria2节点 它们不能放进负载均衡" << std::endl;
+        }
+        if (added == 0) {
+            std::cerr << "没有可以负载均衡的节点" << std::endl;
+            return false;
+        }
+        // 测不出延迟的时候(刚启动 或者全都超时)先走第一个节点
+        std::string fallbackTag = outbounds.front()["tag"];
+        appendBuiltinOutbounds(outbounds);
+        
+        json& routing = config["routing"];
+        const char* strategy = options.strategy == BalancerStrategy::LeastPing ? "leastPing" : "leastLoad";
+        routing["balancers"] = json::array({
+            {
+                {"tag", balancerTag},
+                {"selector", json::array({tagPrefix})},
+                {"strategy", {{"type", strategy}}},
+                {"fallbackTag", fallbackTag}
+            }
+        });
+        // 前面的规则没匹配上的流量都交给负载均衡
+        routing["rules"].push_back({
+            {"type", "field"},
+            {"network", "tcp,udp"},
+            {"balancerTag", balancerTag}
+        });
+        
+        if (options.strategy == BalancerStrategy::LeastPing) {
+            config["observatory"] = {
+                {"subjectSelector", json::array({tagPrefix})},
+                {"probeURL", options.probeUrl},
+                {"probeInterval", options.probeInterval},
+                {"enableConcurrency", true}
+            };
+        } else {
+            config["burstObservatory"] = {
+                {"subjectSelector", json::array({tagPrefix})},
+                {"pingConfig", {
+                    {"destination", options.probeUrl},
+                    {"interval", options.probeInterval},
+                    {"sampling", 3},
+                    {"timeout", "5s"}
+                }}
+            };
+        }
+        
+        if (!writeConfig(config, style)) {
+            return false;
+        }
+        
+        std::cout << "已生成负载均衡配置文件: " << xrayConfigPath << "，共" << added << "个节点" << std::endl;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "生成配置文件时出错: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool ConfigManager::switchViaApi(const NodeRecord& node, const std::string& xrayPath) {
+    // Hysteria2节点要重启本地的hysteria客户端 换Xray的出站不够
+    if (node.get<Hy2Node>()) {
+        return false;
+    }
+    
+    // xray api ado只认文件 里面是{"outbounds": [...]} 出站的标签就是proxy
+    std::string outboundPath = configDir + "switch_outbound.json";
+    try {
+        json config = {{"outbounds", json::array()}};
+        generateOutbound(node, config["outbounds"].emplace_back());
+        if (!writeConfig(config, ConfigStyle::Compact, outboundPath)) {
+            return false;
+        }
+    } catch (const std::exception& e) {
+        // 返回false让调用方退回到重启
+        std::cerr << "生成出站配置时出错: " << e.what() << std::endl;
+        return false;
+    }
+    
+    std::string server = "--server=127.0.0.1:" + std::to_string(kApiPort);
+    // 旧的proxy不在(比如现在跑的是负载均衡的配置)时删除会失败 这时候只能重启
+    bool ok = runProgram({xrayPath, "api", "rmo", server, "proxy"}) == 0 &&
+              runProgram({xrayPath, "api", "ado", server, outboundPath}) == 0;
+    fs::remove(outboundPath);
+    return ok;
+}
+
+SwitchResult ConfigManager::switchNode(const NodeRecord& node, const std::string& xrayPath) {
+    // 不管走哪条路都先写好配置文件 以后重启时用的也是新节点
+    if (!generateXrayConfig(node, ConfigStyle::Pretty)) {
+        return SwitchResult::Failed;
+    }
+    if (!isXrayRunning()) {
+        return SwitchResult::Written;
+    }
+    if (switchViaApi(node, xrayPath)) {
+        return SwitchResult::Api;
+    }
+    std::cout << "无法通过API切换 重启Xray" << std::endl;
+    return restartXray(xrayPath) ? SwitchResult::Restarted : SwitchResult::Failed;
+}
+
 std::string ConfigManager::getXrayConfigPath() const {
     return xrayConfigPath;
 }
@@ -285,22 +446,8 @@ bool ConfigManager::isXrayRunning() {
     CloseHandle(hSnapshot);
     return false;
 #else
-    // Linux检查进程
-    FILE* fp = popen("pgrep -x xray", "r");
-    if (fp == NULL) {
-        return false;
-    }
-    
-    char path[1035];
-    bool found = false;
-    
-    while (fgets(path, sizeof(path)-1, fp) != NULL) {
-        found = true;
-        break;
-    }
-    
-    pclose(fp);
-    return found;
+    // 只看自己启动的那个进程 不用fork pgrep
+    return xray->isRunning();
 #endif
 }
 
@@ -311,36 +458,44 @@ bool ConfigManager::startXray(const std::string& xrayPath) {
     }
     
     // 如果当前节点是Hysteria2，需要先启动Hysteria2
-    Node* node = nullptr;
     DatabaseManager dbManager;
-    if (dbManager.open()) {
+    NodeCatalog catalog(dbManager.getCatalogPath());
+    bool hasCatalog = catalog.refresh();
+    if (hasCatalog || dbManager.open()) {
         // 这里应该根据应用程序中保存的当前节点ID来获取节点
         // 为简单起见，我们将假设数据库中的第一个节点就是当前选中的节点
-        std::vector<Node*> nodes = dbManager.getAllNodes();
-        if (!nodes.empty()) {
-            Node* currentNode = nodes[0];
-            if (currentNode && currentNode->getProtocol() == "hy2") {
-                std::string home = std::getenv("HOME") ? std::getenv("HOME") : ".";
-                std::string configDir = home + "/.heresy/";
-                std::string hy2ConfigPath = configDir + "hy2_config.yaml";
-                
-                // 启动Hysteria2
-                std::string hy2Command;
+        // 只需要知道它的协议 读一行就够了 有节点目录时不用打开数据库
+        bool isHy2 = false;
+        NodeFilter filter;
+        filter.limit = 1;
+        auto check = [&isHy2](const NodeRow& row) {
+            isHy2 = row.protocol == ProtocolTraits<Hy2Node>::name;
+            return false;
+        };
+        if (hasCatalog) {
+            catalog.forEachNode(filter, "", check);
+        } else {
+            dbManager.forEachNode(filter, NodeProjection::Summary, check);
+        }
+        
+        if (isHy2) {
+            std::string home = std::getenv("HOME") ? std::getenv("HOME") : ".";
+            std::string configDir = home + "/.heresy/";
+            std::string hy2ConfigPath = configDir + "hy2_config.yaml";
+            
+            // 启动Hysteria2
 #ifdef _WIN32
-                hy2Command = "start /b hysteria-windows-amd64.exe -c " + hy2ConfigPath + " > nul 2>&1";
-#else
-                hy2Command = "hysteria -c " + hy2ConfigPath + " > /dev/null 2>&1 &";
-#endif
-                system(hy2Command.c_str());
-                
-                // 给Hysteria2一些启动时间
-                std::this_thread::sleep_for(std::chrono::seconds(2));
-            }
+            std::string hy2Command = "start /b hysteria-windows-amd64.exe -c " + hy2ConfigPath + " > nul 2>&1";
+            system(hy2Command.c_str());
             
-            // 释放内存
-            for (auto node : nodes) {
-                delete node;
+            // 给Hysteria2一些启动时间
+            std::this_thread::sleep_for(std::chrono::seconds(2));
+#else
+            // 等它开始监听本机socks5端口 Xray的出站要连过去
+            if (!hysteria->start({{"hysteria", "-c", hy2ConfigPath}, kHysteriaPort})) {
+                return false;
             }
+#endif
         }
     }
     
@@ -348,22 +503,29 @@ bool ConfigManager::startXray(const std::string& xrayPath) {
     // Windows启动进程
     std::string command = "start /b " + xrayPath + " -c " + xrayConfigPath;
     system(command.c_str());
-#else
-    // Linux启动进程
-    std::string command = xrayPath + " -c " + xrayConfigPath + " > /dev/null 2>&1 &";
-    system(command.c_str());
-#endif
     
     // 稍微等待一下，确保进程启动
     std::this_thread::sleep_for(std::chrono::seconds(1));
     
     return isXrayRunning();
+#else
+    // 等socks入站能连上了才算启动好 崩溃了会自动重启
+    if (!xray->start({{xrayPath, "-c", xrayConfigPath}, kSocksPort})) {
+        hysteria->stop();
+        return false;
+    }
+    return true;
+#endif
 }
 
 bool ConfigManager::stopXray() {
     // 先停止Xray
     if (!isXrayRunning()) {
         std::cout << "Xray未在运行" << std::endl;
+#ifndef _WIN32
+        // Xray崩溃太多次没再重启时 跟着它启动的hysteria可能还在
+        hysteria->stop();
+#endif
         return true;
     }
     
@@ -373,16 +535,23 @@ bool ConfigManager::stopXray() {
     
     // 检查是否有Hysteria2在运行，如果有也停止它
     system("taskkill /f /im hysteria-windows-amd64.exe");
-#else
-    // Linux停止进程
-    system("pkill -x xray");
-    
-    // 检查是否有Hysteria2在运行，如果有也停止它
-    system("pkill -x hysteria");
-#endif
     
     // 稍微等待一下，确保进程已停止
     std::this_thread::sleep_for(std::chrono::seconds(1));
     
     return !isXrayRunning();
+#else
+    // 只停自己启动的进程 别的用户的xray不会被误杀 stop()返回时进程已经退出了
+    bool stopped = xray->stop();
+    
+    // Hysteria2是跟着Xray一起启动的 也停掉
+    return hysteria->stop() && stopped;
+#endif
+}
+
+bool ConfigManager::restartXray(const std::string& xrayPath) {
+    if (!stopXray()) {
+        return false;
+    }
+    return startXray(xrayPath);
 } 
\ No newline at end of file
@@ -2,32 +2,102 @@
 #define CONFIG_MANAGER_H
 
 #include <string>
+#include <vector>
 #include <filesystem>
-#include "Node.h"
+#include <memory>
+#include "NodeRecord.h"
+#include "ProcessSupervisor.h"
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
 
+// 配置文件的格式
+enum class ConfigStyle {
+    Pretty,   // 缩进4格 给人看的
+    Compact,  // 不缩进不换行 只给Xray读的 文件小写得也快
+};
+
+// 负载均衡怎么挑节点
+enum class BalancerStrategy {
+    LeastPing,  // 延迟最低的 靠observatory定时测
+    LeastLoad,  // 延迟稳定且低的几个里轮着用 靠burstObservatory定时测
+};
+
+// 负载均衡配置的参数
+struct BalancerOptions {
+    BalancerStrategy strategy = BalancerStrategy::LeastPing;
+    // 测延迟访问的地址 要返回204之类的小响应
+    std::string probeUrl = "https://www.google.com/generate_204";
+    // 多久测一次 Xray的时间格式 比如30s 1m
+    std::string probeInterval = "1m";
+};
+
+// 切换节点的结果
+enum class SwitchResult {
+    Failed,     // 配置文件没写成 或者需要重启但Xray没能重新启动
+    Written,    // 写好了配置文件 Xray没在运行 下次启动时生效
+    Api,        // 通过Xray的API换掉了proxy出站 没有重启 别的连接不受影响
+    Restarted,  // API换不了(比如Hysteria2节点) 写好配置文件后重启了一次Xray
+};
+
 class ConfigManager {
 private:
+    // Xray的API(HandlerService和RoutingService)只监听本机这个端口
+    static constexpr int kApiPort = 10085;
+    // socks入站的端口 Xray开始监听它才算启动好
+    static constexpr int kSocksPort = 10808;
+    // Hy2Node生成的hysteria配置里本机socks5监听的端口
+    static constexpr int kHysteriaPort = 10998;
+    
     std::string configDir;
     std::string xrayConfigPath;
     
+#ifndef _WIN32
+    // 看管xray和hysteria进程 pid文件放在configDir里
+    std::unique_ptr<ProcessSupervisor> xray;
+    std::unique_ptr<ProcessSupervisor> hysteria;
+#endif
+    
     // 默认的路由规则
     json defaultRoutingRules();
     
     // 默认的入站设置
     json defaultInbounds();
     
-    // 根据节点生成出站设置
-    json generateOutbound(const Node* node);
+    // 根据节点生成出站设置 直接写进outbound(一般是outbounds数组里新加的一项)
+    void generateOutbound(const NodeRecord& node, json& outbound);
+    
+    // 没有出站的基本配置 日志 入站和路由
+    json baseConfig();
+    
+    // 直连 屏蔽 DNS这几个固定的出站 加在节点的出站后面
+    void appendBuiltinOutbounds(json& outbounds);
+    
+    // 把配置写进path 先写到旁边的临时文件再改名替换 Xray随时读到的都是完整的文件
+    bool writeConfig(const json& config, ConfigStyle style, const std::string& path);
+    bool writeConfig(const json& config, ConfigStyle style);
+    
+    // 用xray api命令把正在运行的Xray的proxy出站换成node 不重启
+    // 先删掉旧的proxy出站再加上新的 路由最后一条规则按标签指向proxy 所以新出站加在哪都一样
+    bool switchViaApi(const NodeRecord& node, const std::string& xrayPath);
     
 public:
     // 构造函数
     ConfigManager(const std::string& configDir = "~/.heresy/");
     
     // 生成并保存Xray配置文件
-    bool generateXrayConfig(const Node* node);
+    bool generateXrayConfig(const NodeRecord& node, ConfigStyle style = ConfigStyle::Pretty);
+    
+    // 用一组节点生成负载均衡的配置 每个节点一个出站 标签是proxy-节点ID
+    // 路由最后一条把其余流量都交给负载均衡 由observatory测出来的延迟决定走哪个节点
+    // Hysteria2节点要单独跑hysteria客户端 不能放进来 会被跳过
+    // 一个能用的节点都没有时返回false
+    bool generateBalancedConfig(const std::vector<NodeRecord>& nodes, const BalancerOptions& options,
+                                ConfigStyle style = ConfigStyle::Pretty);
+    
+    // 切换到node 先写好配置文件
+    // Xray在运行时优先通过API换出站 不行再重启一次 Xray没在运行时只写配置文件
+    SwitchResult switchNode(const NodeRecord& node, const std::string& xrayPath = "xray");
     
     // 获取Xray配置文件路径
     std::string getXrayConfigPath() const;
@@ -38,11 +108,14 @@ public:
     // 检查Xray进程状态
     bool isXrayRunning();
     
-    // 启动Xray
+    // 启动Xray 等它开始监听socks入站才返回 当前节点是Hysteria2时先启动hysteria
     bool startXray(const std::string& xrayPath = "xray");
     
-    // 停止Xray
+    // 停止Xray和hysteria
     bool stopXray();
+    
+    // 重启Xray 让它读新的配置文件
+    bool restartXray(const std::string& xrayPath = "xray");
 };
 
 #endif 
\ No newline at end of file
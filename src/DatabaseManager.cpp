@@ -1,14 +1,82 @@
 #include "DatabaseManager.h"
+#include "NodeCatalog.h"
+#include "ProtocolTraits.h"
 #include <iostream>
 #include <filesystem>
 #include <cstdlib>
-#include "VlessNode.h"
-#include "VmessNode.h"
-#include "TrojanNode.h"
-#include "Hy2Node.h"
-
+#include <deque>
+#include <unordered_map>
 namespace fs = std::filesystem;
 
+// 读出订阅表第3~5列的缓存信息(etag, last_modified, content_hash)
+static void readSubscribeCache(sqlite3_stmt* stmt, Subscribe& subscribe) {
+    const char* etag = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+    const char* lastModified = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+    const char* contentHash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+    subscribe.setEtag(etag ? etag : "");
+    subscribe.setLastModified(lastModified ? lastModified : "");
+    subscribe.setContentHash(contentHash ? contentHash : "");
+}
+
+// 从first开始依次绑定节点表的protocol ~ content_hash共24列 插入和更新共用
+// 节点自己的文本用SQLITE_STATIC直接绑定不复制 调用方在step之前不会动record
+// uuid 指纹 内容哈希和extra_params是现算出来的临时字符串 只能让SQLite复制一份
+static void bindNodeFields(sqlite3_stmt* stmt, const NodeRecord& record, int first) {
+    NodeColumns columns = columnsFromNode(record);
+    const Node& node = record.node();
+    int index = first;
+    // 空的string_view可能data()是空指针 SQLite会当成NULL绑定 违反NOT NULL 所以换成""
+    auto bindView = [stmt, &index](std::string_view value) {
+        sqlite3_bind_text(stmt, index++, value.data() ? value.data() : "", static_cast<int>(value.size()),
+                          SQLITE_STATIC);
+    };
+    auto bindCopy = [stmt, &index](const std::string& value) {
+        sqlite3_bind_text(stmt, index++, value.c_str(), static_cast<int>(value.size()), SQLITE_TRANSIENT);
+    };
+    
+    bindView(node.getProtocol());
+    bindCopy(node.getUuid());
+    bindView(node.getAddr());
+    sqlite3_bind_int(stmt, index++, node.getPort());
+    bindView(node.getInfo());
+    bindView(columns.type);
+    bindView(columns.encryption);
+    bindView(columns.security);
+    bindView(columns.sni);
+    bindView(columns.host);
+    bindView(columns.path);
+    bindView(columns.serviceName);
+    bindView(columns.flow);
+    bindView(columns.tlsFingerprint);
+    bindView(columns.publicKey);
+    bindView(columns.shortId);
+    bindView(columns.alpn);
+    bindView(columns.obfs);
+    bindView(columns.obfsPassword);
+    sqlite3_bind_int(stmt, index++, columns.alterId);
+    sqlite3_bind_int(stmt, index++, columns.insecure ? 1 : 0);
+    bindCopy(columns.extraParams);
+    bindCopy(node.getFingerprint());
+    bindCopy(node.getContentHash());
+}
+
+// bindNodeFields绑定的列 顺序要和它一致
+#define NODE_FIELD_COLUMNS "protocol, uuid, addr, port, info, type, encryption, security, " \
+    "sni, host, path, service_name, flow, tls_fingerprint, public_key, short_id, alpn, " \
+    "obfs, obfs_password, alter_id, insecure, extra_params, fingerprint, content_hash"
+static const int kNodeFieldCount = 24;
+
+// 已经有同样指纹的节点时 新节点成为它的别名 ?24是上面绑定的fingerprint
+static const char* const kInsertNodeSql =
+    "INSERT INTO nodes (subscribe_id, " NODE_FIELD_COLUMNS ", canonical_id) "
+    "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, "
+    "(SELECT id FROM nodes WHERE fingerprint = ?24 AND canonical_id IS NULL));";
+static_assert(kNodeFieldCount == 24, "kInsertNodeSql里fingerprint的参数位置要跟着改");
+static const char* const kUpdateNodeSql =
+    "UPDATE nodes SET (" NODE_FIELD_COLUMNS ") = "
+    "(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?) WHERE id = ?;";
+static const char* const kDeleteNodeSql = "DELETE FROM nodes WHERE id = ?;";
+
 DatabaseManager::DatabaseManager(const std::string& dbPath) : db(nullptr) {
     // 处理路径中的~符号，指向用户主目录
     if (dbPath.substr(0, 1) == "~") {
@@ -21,6 +89,7 @@ DatabaseManager::DatabaseManager(const std::string& dbPath) : db(nullptr) {
     } else {
         this->dbPath = dbPath;
     }
+    catalogPath = fs::path(this->dbPath).replace_extension(".catalog").string();
     
     // 确保目录存在
     fs::path dir = fs::path(this->dbPath).parent_path();
@@ -42,25 +111,141 @@ bool DatabaseManager::open() {
         return false;
     }
     
-    // 初始化数据库表结构
-    initDatabase();
+    // 后台更新订阅和前台CLI会同时用这个数据库 被锁住时等一会儿而不是直接报错
+    sqlite3_busy_timeout(db, kBusyTimeoutMs);
+    
+    // WAL模式下读写互不阻塞 synchronous=NORMAL在WAL下断电也不会损坏数据库 只可能丢最后几个事务
+    // foreign_keys默认是关的 不打开的话建表时声明的ON DELETE CASCADE不起作用
+    const char* pragmas = R"(
+        PRAGMA journal_mode = WAL;
+        PRAGMA synchronous = NORMAL;
+        PRAGMA foreign_keys = ON;
+        PRAGMA mmap_size = 67108864;
+    )";
+    char* errMsg = nullptr;
+    sqlite3_exec(db, pragmas, nullptr, nullptr, &errMsg);
+    if (errMsg) {
+        std::cerr << "设置数据库参数失败: " << errMsg << std::endl;
+        sqlite3_free(errMsg);
+    }
+    
+    // 初始化数据库表结构 升级失败时不能按新的表结构读写
+    if (!initDatabase()) {
+        close();
+        return false;
+    }
+    
+    sqlite3_stmt* stmt = prepare("SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'nodes_fts';");
+    if (stmt) {
+        hasFullTextIndex = sqlite3_step(stmt) == SQLITE_ROW;
+        sqlite3_reset(stmt);
+    }
     
     return true;
 }
 
 void DatabaseManager::close() {
     if (db) {
+        // 缓存的语句必须先释放 否则连接关不掉
+        for (auto& entry : statements) {
+            sqlite3_finalize(entry.second);
+        }
+        statements.clear();
         sqlite3_close(db);
         db = nullptr;
     }
 }
 
-void DatabaseManager::initDatabase() {
+sqlite3_stmt* DatabaseManager::prepare(const std::string& sql) {
+    auto it = statements.find(sql);
+    if (it != statements.end()) {
+        // 上一次用完可能没有走完 先重置 再清掉上次绑定的参数
+        sqlite3_reset(it->second);
+        sqlite3_clear_bindings(it->second);
+        return it->second;
+    }
+    
+    sqlite3_stmt* stmt = nullptr;
+    // PERSISTENT告诉SQLite这条语句会被用很多次
+    if (sqlite3_prepare_v3(db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_finalize(stmt);
+        return nullptr;
+    }
+    statements.emplace(sql, stmt);
+    return stmt;
+}
+
+bool DatabaseManager::initDatabase() {
+    int version = getSchemaVersion();
+    if (version == kSchemaVersion) {
+        return true;
+    }
+    if (version > kSchemaVersion) {
+        std::cerr << "数据库是更新版本的程序创建的(版本" << version << ")，可能无法正常使用" << std::endl;
+        return true;
+    }
+    
+    // 升级过程放在一个事务里 中途失败不会留下半新半旧的表结构
+    TransactionGuard transaction(*this);
+    if (!transaction.begin()) {
+        return false;
+    }
+    invalidateCatalog();
+    
+    bool ok = (version >= 1 || migrateToVersion1()) &&
+              (version >= 2 || migrateToVersion2()) &&
+              (version >= 3 || migrateToVersion3()) &&
+              (version >= 4 || migrateToVersion4());
+    if (ok) {
+        std::string setVersion = "PRAGMA user_version = " + std::to_string(kSchemaVersion) + ";";
+        ok = exec(setVersion.c_str(), "更新表结构版本错误");
+    }
+    if (!ok) {
+        // 版本号还是旧的 下次打开时从头再升级一次
+        std::cerr << "升级数据库失败，已回滚到版本" << version << std::endl;
+        transaction.rollback();
+        return false;
+    }
+    return transaction.commit();
+}
+
+int DatabaseManager::getSchemaVersion() {
+    int version = 0;
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db) << std::endl;
+        return version;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        version = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return version;
+}
+
+bool DatabaseManager::exec(const char* sql, const char* what) {
+    char* errMsg = nullptr;
+    sqlite3_exec(db, sql, nullptr, nullptr, &errMsg);
+    if (errMsg) {
+        std::cerr << what << ": " << errMsg << std::endl;
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+// 版本1: 订阅表和节点表 以及后来加上的缓存列和指纹列
+// 没有版本号的旧数据库也走这里 表已经存在时只补上缺的列
+bool DatabaseManager::migrateToVersion1() {
     const char* createSubscribeTable = R"(
         CREATE TABLE IF NOT EXISTS subscribes (
             id INTEGER PRIMARY KEY AUTOINCREMENT,
             name TEXT NOT NULL,
-            url TEXT NOT NULL
+            url TEXT NOT NULL,
+            etag TEXT NOT NULL DEFAULT '',
+            last_modified TEXT NOT NULL DEFAULT '',
+            content_hash TEXT NOT NULL DEFAULT ''
         );
     )";
     
@@ -77,30 +262,185 @@ void DatabaseManager::initDatabase() {
             encryption TEXT,
             security TEXT,
             extra_params TEXT,
+            fingerprint TEXT NOT NULL DEFAULT '',
+            content_hash TEXT NOT NULL DEFAULT '',
             FOREIGN KEY (subscribe_id) REFERENCES subscribes (id) ON DELETE CASCADE
         );
     )";
     
+    if (!exec(createSubscribeTable, "创建订阅表错误") || !exec(createNodeTable, "创建节点表错误")) {
+        return false;
+    }
+
+    // 旧数据库里的表没有这几列
+    if (!addColumnIfMissing("subscribes", "etag", "TEXT NOT NULL DEFAULT ''") ||
+        !addColumnIfMissing("subscribes", "last_modified", "TEXT NOT NULL DEFAULT ''") ||
+        !addColumnIfMissing("subscribes", "content_hash", "TEXT NOT NULL DEFAULT ''") ||
+        !addColumnIfMissing("nodes", "fingerprint", "TEXT NOT NULL DEFAULT ''") ||
+        !addColumnIfMissing("nodes", "content_hash", "TEXT NOT NULL DEFAULT ''")) {
+        return false;
+    }
+    
+    // 以前外键没有打开 删除订阅时可能留下了不属于任何订阅的节点
+    // 这些节点本该被级联删除 留着的话以后修改它们会违反外键约束
+    return exec("DELETE FROM nodes WHERE subscribe_id NOT IN (SELECT id FROM subscribes);",
+                "清理无主节点错误");
+}
+
+bool DatabaseManager::addColumnIfMissing(const std::string& table, const std::string& column,
+                                         const std::string& definition) {
+    std::string sql = "PRAGMA table_info(" + table + ");";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+
+    bool found = false;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        if (name && column == name) {
+            found = true;
+            break;
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    if (found) {
+        return true;
+    }
+
+    std::string alter = "ALTER TABLE " + table + " ADD COLUMN " + column + " " + definition + ";";
+    return exec(alter.c_str(), "升级表结构错误");
+}
+
+// 版本2: 各协议的参数都有地方存了 以前只存了vless的type/encryption/security
+bool DatabaseManager::migrateToVersion2() {
+    const char* textColumns[] = {
+        "sni", "host", "path", "service_name", "flow", "tls_fingerprint",
+        "public_key", "short_id", "alpn", "obfs", "obfs_password",
+    };
+    for (const char* column : textColumns) {
+        if (!addColumnIfMissing("nodes", column, "TEXT NOT NULL DEFAULT ''")) {
+            return false;
+        }
+    }
+    if (!addColumnIfMissing("nodes", "alter_id", "INTEGER NOT NULL DEFAULT 0") ||
+        !addColumnIfMissing("nodes", "insecure", "INTEGER NOT NULL DEFAULT 0")) {
+        return false;
+    }
+    
+    // 已经存进来的节点丢了参数 只能重新下载一次订阅补上
+    // 清掉内容哈希和条件请求的缓存 下次更新时每个节点都会被当作有变化原地重写 id不变
+    return exec("UPDATE nodes SET content_hash = '';", "清除节点哈希错误") &&
+           exec("UPDATE subscribes SET etag = '', last_modified = '', content_hash = '';",
+                "清除订阅缓存错误");
+}
+
+// 版本3: 常用查询条件的索引 和别名/地址的全文索引
+bool DatabaseManager::migrateToVersion3() {
+    const char* createIndexes = R"(
+        CREATE INDEX IF NOT EXISTS idx_nodes_subscribe ON nodes (subscribe_id);
+        CREATE INDEX IF NOT EXISTS idx_nodes_protocol ON nodes (protocol);
+        CREATE INDEX IF NOT EXISTS idx_nodes_addr ON nodes (addr);
+    )";
+    
+    if (!exec(createIndexes, "创建索引错误")) {
+        return false;
+    }
+    
+    // 外部内容表 只存索引不存原文 由触发器跟着nodes表更新
+    // trigram分词对中文别名也有效 不需要按空格分词
+    const char* createFullTextIndex = R"(
+        CREATE VIRTUAL TABLE IF NOT EXISTS nodes_fts USING fts5(
+            info, addr, content = 'nodes', content_rowid = 'id', tokenize = 'trigram'
+        );
+        CREATE TRIGGER IF NOT EXISTS nodes_fts_insert AFTER INSERT ON nodes BEGIN
+            INSERT INTO nodes_fts (rowid, info, addr) VALUES (new.id, new.info, new.addr);
+        END;
+        CREATE TRIGGER IF NOT EXISTS nodes_fts_delete AFTER DELETE ON nodes BEGIN
+            INSERT INTO nodes_fts (nodes_fts, rowid, info, addr) VALUES ('delete', old.id, old.info, old.addr);
+        END;
+        CREATE TRIGGER IF NOT EXISTS nodes_fts_update AFTER UPDATE OF info, addr ON nodes BEGIN
+            INSERT INTO nodes_fts (nodes_fts, rowid, info, addr) VALUES ('delete', old.id, old.info, old.addr);
+            INSERT INTO nodes_fts (rowid, info, addr) VALUES (new.id, new.info, new.addr);
+        END;
+        INSERT INTO nodes_fts (nodes_fts) VALUES ('rebuild');
+    )";
+    
+    // 放在保存点里 失败时只撤销全文索引这一部分 不会留下建了一半的表和触发器
+    if (!exec("SAVEPOINT full_text_index;", "创建全文索引失败")) {
+        return false;
+    }
     char* errMsg = nullptr;
-    sqlite3_exec(db, createSubscribeTable, nullptr, nullptr, &errMsg);
-    if (errMsg) {
-        std::cerr << "创建订阅表错误: " << errMsg << std::endl;
-        sqlite3_free(errMsg);
+    sqlite3_exec(db, createFullTextIndex, nullptr, nullptr, &errMsg);
+    if (!errMsg) {
+        return exec("RELEASE full_text_index;", "创建全文索引失败");
     }
     
-    sqlite3_exec(db, createNodeTable, nullptr, nullptr, &errMsg);
-    if (errMsg) {
-        std::cerr << "创建节点表错误: " << errMsg << std::endl;
-        sqlite3_free(errMsg);
+    // SQLite编译时没带FTS5也能用 只是搜索慢一些 别的错误算升级失败
+    std::string error = errMsg;
+    sqlite3_free(errMsg);
+    exec("ROLLBACK TO full_text_index; RELEASE full_text_index;", "撤销全文索引失败");
+    if (error.find("no such module") != std::string::npos || error.find("no such tokenizer") != std::string::npos) {
+        std::cerr << "创建全文索引失败，搜索将逐行匹配: " << error << std::endl;
+        return true;
     }
+    std::cerr << "创建全文索引错误: " << error << std::endl;
+    return false;
+}
+
+// 版本4: 不同订阅里连接参数相同的节点 只保留一个作为正本 其余的作为它的别名
+// canonical_id为空的是正本 否则指向正本的id 每个指纹最多一个正本
+bool DatabaseManager::migrateToVersion4() {
+    if (!addColumnIfMissing("nodes", "canonical_id", "INTEGER")) {
+        return false;
+    }
+    
+    // 指纹的算法改过(地址不区分大小写) 按现在的算法重新算一遍
+    sqlite3_stmt* stmt = prepare("UPDATE nodes SET fingerprint = ? WHERE id = ?;");
+    if (!stmt) {
+        return false;
+    }
+    for (const NodeRecord& record : getNodes(NodeFilter())) {
+        std::string fingerprint = record.node().getFingerprint();
+        sqlite3_bind_text(stmt, 1, fingerprint.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, record.node().getId());
+        int rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE) {
+            std::cerr << "重新计算指纹错误: " << sqlite3_errmsg(db) << std::endl;
+            return false;
+        }
+    }
+    
+    // 每个指纹id最小的节点是正本
+    // 正本被删除时(包括删除订阅时级联删除) 由触发器把它id最小的别名升为正本 其余别名改指过去
+    const char* assignCanonical = R"(
+        UPDATE nodes SET canonical_id = NULLIF(first.id, nodes.id)
+        FROM (SELECT fingerprint, MIN(id) AS id FROM nodes GROUP BY fingerprint) AS first
+        WHERE first.fingerprint = nodes.fingerprint;
+        
+        CREATE UNIQUE INDEX IF NOT EXISTS idx_nodes_canonical ON nodes (fingerprint) WHERE canonical_id IS NULL;
+        CREATE INDEX IF NOT EXISTS idx_nodes_alias ON nodes (canonical_id) WHERE canonical_id IS NOT NULL;
+        
+        CREATE TRIGGER IF NOT EXISTS nodes_promote_alias AFTER DELETE ON nodes WHEN old.canonical_id IS NULL BEGIN
+            UPDATE nodes SET canonical_id = NULL
+                WHERE id = (SELECT MIN(id) FROM nodes WHERE canonical_id = old.id);
+            UPDATE nodes SET canonical_id = (SELECT id FROM nodes WHERE fingerprint = old.fingerprint AND canonical_id IS NULL)
+                WHERE canonical_id = old.id;
+        END;
+    )";
+    
+    return exec(assignCanonical, "合并重复节点错误");
 }
 
 bool DatabaseManager::addSubscribe(const Subscribe& subscribe) {
     const char* sql = "INSERT INTO subscribes (name, url) VALUES (?, ?);";
     
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db) << std::endl;
+    sqlite3_stmt* stmt = prepare(sql);
+    if (!stmt) {
         return false;
     }
     
@@ -109,58 +449,77 @@ bool DatabaseManager::addSubscribe(const Subscribe& subscribe) {
     sqlite3_bind_text(stmt, 2, subscribe.getUrl().c_str(), -1, SQLITE_TRANSIENT);
     
     bool result = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     
     return result;
 }
 
 bool DatabaseManager::updateSubscribe(const Subscribe& subscribe) {
-    const char* sql = "UPDATE subscribes SET name = ?, url = ? WHERE id = ?;";
+    // 链接变了的话Subscribe里的缓存信息已经被清空 这里一起写回去
+    const char* sql = "UPDATE subscribes SET name = ?, url = ?, etag = ?, last_modified = ?, content_hash = ? WHERE id = ?;";
     
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db) << std::endl;
+    sqlite3_stmt* stmt = prepare(sql);
+    if (!stmt) {
         return false;
     }
     
     // 使用SQLITE_TRANSIENT确保SQLite会复制字符串
     sqlite3_bind_text(stmt, 1, subscribe.getName().c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 2, subscribe.getUrl().c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_int(stmt, 3, subscribe.getId());
+    sqlite3_bind_text(stmt, 3, subscribe.getEtag().c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 4, subscribe.getLastModified().c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 5, subscribe.getContentHash().c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 6, subscribe.getId());
     
     bool result = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     
     return result;
 }
 
-bool DatabaseManager::deleteSubscribe(int id) {
-    // 首先删除该订阅下的所有节点
-    deleteAllNodesInSubscribe(id);
+bool DatabaseManager::updateSubscribeCache(const Subscribe& subscribe) {
+    const char* sql = "UPDATE subscribes SET etag = ?, last_modified = ?, content_hash = ? WHERE id = ?;";
+    
+    sqlite3_stmt* stmt = prepare(sql);
+    if (!stmt) {
+        return false;
+    }
     
+    sqlite3_bind_text(stmt, 1, subscribe.getEtag().c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, subscribe.getLastModified().c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 3, subscribe.getContentHash().c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 4, subscribe.getId());
+    
+    bool result = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_reset(stmt);
+    
+    return result;
+}
+
+bool DatabaseManager::deleteSubscribe(int id) {
+    invalidateCatalog();
+    // 该订阅下的所有节点由外键的ON DELETE CASCADE一起删除
     const char* sql = "DELETE FROM subscribes WHERE id = ?;";
     
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db) << std::endl;
+    sqlite3_stmt* stmt = prepare(sql);
+    if (!stmt) {
         return false;
     }
     
     sqlite3_bind_int(stmt, 1, id);
     
     bool result = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     
     return result;
 }
 
 std::vector<Subscribe> DatabaseManager::getAllSubscribes() {
     std::vector<Subscribe> subscribes;
-    const char* sql = "SELECT id, name, url FROM subscribes;";
+    const char* sql = "SELECT id, name, url, etag, last_modified, content_hash FROM subscribes;";
     
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db) << std::endl;
+    sqlite3_stmt* stmt = prepare(sql);
+    if (!stmt) {
         return subscribes;
     }
     
@@ -178,19 +537,20 @@ std::vector<Subscribe> DatabaseManager::getAllSubscribes() {
             url = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
         }
         
-        subscribes.emplace_back(id, name, url);
+        Subscribe subscribe(id, name, url);
+        readSubscribeCache(stmt, subscribe);
+        subscribes.push_back(subscribe);
     }
     
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     return subscribes;
 }
 
 Subscribe DatabaseManager::getSubscribeById(int id) {
-    const char* sql = "SELECT id, name, url FROM subscribes WHERE id = ?;";
+    const char* sql = "SELECT id, name, url, etag, last_modified, content_hash FROM subscribes WHERE id = ?;";
     
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db) << std::endl;
+    sqlite3_stmt* stmt = prepare(sql);
+    if (!stmt) {
         return Subscribe(0, "", "");
     }
     
@@ -209,463 +569,685 @@ Subscribe DatabaseManager::getSubscribeById(int id) {
             url = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
         }
         
-        sqlite3_finalize(stmt);
-        return Subscribe(dbId, name, url);
+        Subscribe subscribe(dbId, name, url);
+        readSubscribeCache(stmt, subscribe);
+        sqlite3_reset(stmt);
+        return subscribe;
     }
     
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     return Subscribe(0, "", "");
 }
 
-bool DatabaseManager::addNode(Node* node, int subscribeId) {
-    const char* sql = "INSERT INTO nodes (subscribe_id, protocol, uuid, addr, port, info, type, encryption, security, extra_params) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
-    
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db) << std::endl;
+bool DatabaseManager::addNode(NodeRecord& node, int subscribeId) {
+    invalidateCatalog();
+    sqlite3_stmt* stmt = prepare(kInsertNodeSql);
+    if (!stmt) {
         return false;
     }
     
     sqlite3_bind_int(stmt, 1, subscribeId);
-    sqlite3_bind_text(stmt, 2, node->getProtocol().c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 3, node->getUuid().c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 4, node->getAddr().c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 5, node->getPort());
-    sqlite3_bind_text(stmt, 6, node->getInfo().c_str(), -1, SQLITE_STATIC);
-    
-    // 针对不同类型节点的额外属性
-    if (node->getProtocol() == "vless") {
-        VlessNode* vlessNode = static_cast<VlessNode*>(node);
-        sqlite3_bind_text(stmt, 7, vlessNode->getType().c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 8, vlessNode->getEncryption().c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 9, vlessNode->getSecurity().c_str(), -1, SQLITE_STATIC);
-        
-        // 简单处理，后面可以改进为JSON格式
-        sqlite3_bind_text(stmt, 10, "", -1, SQLITE_STATIC);
-    } else {
-        // 其他协议节点的处理
-        sqlite3_bind_text(stmt, 7, "", -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 8, "", -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 9, "", -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 10, "", -1, SQLITE_STATIC);
-    }
+    bindNodeFields(stmt, node, 2);
     
     bool result = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     
     if (result) {
         // 设置节点ID为最后插入的ID
-        node->setId(sqlite3_last_insert_rowid(db));
+        node.node().setId(sqlite3_last_insert_rowid(db));
     }
     
     return result;
 }
 
-bool DatabaseManager::updateNode(Node* node) {
-    const char* sql = "UPDATE nodes SET protocol = ?, uuid = ?, addr = ?, port = ?, info = ?, type = ?, encryption = ?, security = ?, extra_params = ? WHERE id = ?;";
+bool DatabaseManager::addNodes(std::vector<NodeRecord>& nodes, int subscribeId) {
+    if (nodes.empty()) {
+        return true;
+    }
+    invalidateCatalog();
     
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db) << std::endl;
+    // 调用方已经开了事务时直接用它的(出错时由调用方回滚) 否则自己开一个
+    bool ownTransaction = sqlite3_get_autocommit(db) != 0;
+    TransactionGuard transaction(*this);
+    if (ownTransaction && !transaction.begin()) {
         return false;
     }
     
-    sqlite3_bind_text(stmt, 1, node->getProtocol().c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, node->getUuid().c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 3, node->getAddr().c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 4, node->getPort());
-    sqlite3_bind_text(stmt, 5, node->getInfo().c_str(), -1, SQLITE_STATIC);
+    std::vector<NodeRecord*> pointers;
+    pointers.reserve(nodes.size());
+    for (NodeRecord& node : nodes) {
+        pointers.push_back(&node);
+    }
     
-    // 针对不同类型节点的额外属性
-    if (node->getProtocol() == "vless") {
-        VlessNode* vlessNode = static_cast<VlessNode*>(node);
-        sqlite3_bind_text(stmt, 6, vlessNode->getType().c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 7, vlessNode->getEncryption().c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 8, vlessNode->getSecurity().c_str(), -1, SQLITE_STATIC);
-        
-        // 简单处理，后面可以改进为JSON格式
-        sqlite3_bind_text(stmt, 9, "", -1, SQLITE_STATIC);
-    } else {
-        // 其他协议节点的处理
-        sqlite3_bind_text(stmt, 6, "", -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 7, "", -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 8, "", -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 9, "", -1, SQLITE_STATIC);
+    bool result = insertNodes(pointers, subscribeId);
+    if (result && ownTransaction) {
+        result = transaction.commit();
+    }
+    if (!result) {
+        transaction.rollback();
+        // 回滚了 设置过的id都不算数
+        for (NodeRecord& node : nodes) {
+            node.node().setId(0);
+        }
+        return false;
+    }
+    return true;
+}
+
+bool DatabaseManager::insertNodes(const std::vector<NodeRecord*>& nodes, int subscribeId) {
+    if (nodes.empty()) {
+        return true;
     }
     
-    sqlite3_bind_int(stmt, 10, node->getId());
+    sqlite3_stmt* stmt = prepare(kInsertNodeSql);
+    if (!stmt) {
+        return false;
+    }
+    
+    bool result = true;
+    for (NodeRecord* node : nodes) {
+        sqlite3_bind_int(stmt, 1, subscribeId);
+        bindNodeFields(stmt, *node, 2);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            std::cerr << "插入节点失败: " << sqlite3_errmsg(db) << std::endl;
+            result = false;
+            break;
+        }
+        node->node().setId(static_cast<int>(sqlite3_last_insert_rowid(db)));
+        // 同一条语句接着用 只需要重置 不用重新编译
+        sqlite3_reset(stmt);
+    }
+    sqlite3_reset(stmt);
+    return result;
+}
+
+bool DatabaseManager::updateNode(const NodeRecord& node) {
+    invalidateCatalog();
+    sqlite3_stmt* stmt = prepare(kUpdateNodeSql);
+    if (!stmt) {
+        return false;
+    }
+    
+    bindNodeFields(stmt, node, 1);
+    sqlite3_bind_int(stmt, kNodeFieldCount + 1, node.node().getId());
     
     bool result = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     
     return result;
 }
 
 bool DatabaseManager::deleteNode(int id) {
-    const char* sql = "DELETE FROM nodes WHERE id = ?;";
-    
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db) << std::endl;
+    invalidateCatalog();
+    sqlite3_stmt* stmt = prepare(kDeleteNodeSql);
+    if (!stmt) {
         return false;
     }
     
     sqlite3_bind_int(stmt, 1, id);
     
     bool result = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     
     return result;
 }
 
 bool DatabaseManager::deleteAllNodesInSubscribe(int subscribeId) {
+    invalidateCatalog();
     const char* sql = "DELETE FROM nodes WHERE subscribe_id = ?;";
     
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db) << std::endl;
+    sqlite3_stmt* stmt = prepare(sql);
+    if (!stmt) {
         return false;
     }
     
     sqlite3_bind_int(stmt, 1, subscribeId);
     
     bool result = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     
     return result;
 }
 
-std::vector<Node*> DatabaseManager::getAllNodes() {
-    std::vector<Node*> nodes;
-    const char* sql = "SELECT id, protocol, uuid, addr, port, info, type, encryption, security, extra_params FROM nodes;";
+// 读出一列文本 NULL当作空字符串 结果指向SQLite的缓冲区 下一次step之前有效
+static std::string_view columnText(sqlite3_stmt* stmt, int column) {
+    const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+    if (!text) {
+        return std::string_view();
+    }
+    return std::string_view(text, static_cast<size_t>(sqlite3_column_bytes(stmt, column)));
+}
+
+// 按过滤条件拼出WHERE子句 条件的组合只有几种 拼出来的SQL也就只有几条 都能进语句缓存
+// 过滤条件对应的" AND ..."片段 没有条件时为空
+static std::string nodeConditions(const NodeFilter& filter) {
+    std::string where;
+    if (filter.id > 0) {
+        where += " AND id = ?";
+    }
+    if (filter.subscribeId > 0) {
+        where += " AND subscribe_id = ?";
+    }
+    if (!filter.protocol.empty()) {
+        where += " AND protocol = ?";
+    }
+    if (!filter.security.empty()) {
+        where += " AND security = ?";
+    }
+    if (filter.canonicalOnly) {
+        where += " AND canonical_id IS NULL";
+    }
+    if (filter.afterId > 0) {
+        where += " AND id > ?";
+    }
+    if (filter.beforeId > 0) {
+        where += " AND id < ?";
+    }
+    return where;
+}
+
+// 排序和行数限制 limit要在过滤条件之后绑定
+static std::string nodeOrderClause(const NodeFilter& filter) {
+    std::string order = filter.beforeId > 0 ? " ORDER BY id DESC" : " ORDER BY id";
+    if (filter.limit > 0) {
+        order += " LIMIT ?";
+    }
+    return order;
+}
+
+static std::string nodeWhereClause(const NodeFilter& filter) {
+    std::string where = nodeConditions(filter);
+    if (where.empty()) {
+        return where;
+    }
+    return " WHERE" + where.substr(4);
+}
+
+// 从first开始按nodeConditions的顺序绑定参数 返回下一个参数的位置
+static int bindNodeFilter(sqlite3_stmt* stmt, const NodeFilter& filter, int first = 1) {
+    int index = first;
+    if (filter.id > 0) {
+        sqlite3_bind_int(stmt, index++, filter.id);
+    }
+    if (filter.subscribeId > 0) {
+        sqlite3_bind_int(stmt, index++, filter.subscribeId);
+    }
+    if (!filter.protocol.empty()) {
+        sqlite3_bind_text(stmt, index++, filter.protocol.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    if (!filter.security.empty()) {
+        sqlite3_bind_text(stmt, index++, filter.security.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    if (filter.afterId > 0) {
+        sqlite3_bind_int(stmt, index++, filter.afterId);
+    }
+    if (filter.beforeId > 0) {
+        sqlite3_bind_int(stmt, index++, filter.beforeId);
+    }
+    return index;
+}
+
+// Summary和Full共有的列 Full再接着读kNodeFullColumns
+#define NODE_SUMMARY_COLUMNS "id, subscribe_id, protocol, addr, port, info, security, canonical_id"
+static const char* const kNodeFullColumns =
+    ", uuid, type, encryption, sni, host, path, service_name, flow, tls_fingerprint, "
+    "public_key, short_id, alpn, obfs, obfs_password, alter_id, insecure, extra_params";
+
+// 把当前行按NODE_SUMMARY_COLUMNS(和kNodeFullColumns)的顺序读进row
+static void readNodeRow(sqlite3_stmt* stmt, NodeProjection projection, NodeRow& row) {
+    row.id = sqlite3_column_int(stmt, 0);
+    row.subscribeId = sqlite3_column_int(stmt, 1);
+    row.protocol = columnText(stmt, 2);
+    row.addr = columnText(stmt, 3);
+    row.port = sqlite3_column_int(stmt, 4);
+    row.info = columnText(stmt, 5);
+    row.security = columnText(stmt, 6);
+    row.canonicalId = sqlite3_column_int(stmt, 7);
+    if (projection == NodeProjection::Full) {
+        row.uuid = columnText(stmt, 8);
+        row.type = columnText(stmt, 9);
+        row.encryption = columnText(stmt, 10);
+        row.sni = columnText(stmt, 11);
+        row.host = columnText(stmt, 12);
+        row.path = columnText(stmt, 13);
+        row.serviceName = columnText(stmt, 14);
+        row.flow = columnText(stmt, 15);
+        row.tlsFingerprint = columnText(stmt, 16);
+        row.publicKey = columnText(stmt, 17);
+        row.shortId = columnText(stmt, 18);
+        row.alpn = columnText(stmt, 19);
+        row.obfs = columnText(stmt, 20);
+        row.obfsPassword = columnText(stmt, 21);
+        row.alterId = sqlite3_column_int(stmt, 22);
+        row.insecure = sqlite3_column_int(stmt, 23) != 0;
+        row.extraParams = columnText(stmt, 24);
+    }
+}
+
+bool DatabaseManager::forEachNode(const NodeFilter& filter, NodeProjection projection,
+                                  const std::function<bool(const NodeRow&)>& callback) {
+    // 只取需要的列 列表用不到的字段不从数据库里读出来
+    std::string sql = "SELECT " NODE_SUMMARY_COLUMNS;
+    if (projection == NodeProjection::Full) {
+        sql += kNodeFullColumns;
+    }
+    sql += " FROM nodes";
+    sql += nodeWhereClause(filter);
+    sql += nodeOrderClause(filter);
+    sql += ";";
     
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db) << std::endl;
-        return nodes;
+    sqlite3_stmt* stmt = prepare(sql);
+    if (!stmt) {
+        return false;
     }
     
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        int id = sqlite3_column_int(stmt, 0);
-        const char* protocol = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        const char* uuid = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        const char* addr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        int port = sqlite3_column_int(stmt, 4);
-        const char* info = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+    int index = bindNodeFilter(stmt, filter);
+    if (filter.limit > 0) {
+        sqlite3_bind_int(stmt, index, filter.limit);
+    }
+    
+    NodeRow row;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        readNodeRow(stmt, projection, row);
         
-        Node* node = nullptr;
-        std::string protocolStr(protocol ? protocol : "");
+        if (!callback(row)) {
+            rc = SQLITE_DONE;
+            break;
+        }
+    }
+    
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE;
+}
+
+// UTF-8字符数 trigram按字符而不是字节切分
+static size_t utf8Length(std::string_view text) {
+    size_t count = 0;
+    for (char c : text) {
+        if ((static_cast<unsigned char>(c) & 0xC0) != 0x80) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// 把一个词变成FTS5的短语 双引号里的双引号要写两遍
+static std::string ftsPhrase(std::string_view term) {
+    std::string phrase = "\"";
+    for (char c : term) {
+        if (c == '"') {
+            phrase += '"';
+        }
+        phrase += c;
+    }
+    phrase += '"';
+    return phrase;
+}
+
+// 把一个词变成LIKE的模式 %和_要转义
+static std::string likePattern(std::string_view term) {
+    std::string pattern = "%";
+    for (char c : term) {
+        if (c == '%' || c == '_' || c == '\\') {
+            pattern += '\\';
+        }
+        pattern += c;
+    }
+    pattern += '%';
+    return pattern;
+}
+
+bool DatabaseManager::searchNodes(const std::string& query, const NodeFilter& filter,
+                                  const std::function<bool(const NodeRow&)>& callback) {
+    // 能走全文索引的词合成一个MATCH表达式 剩下的词逐个LIKE
+    std::string match;
+    std::vector<std::string> likes;
+    std::string_view rest = query;
+    while (!rest.empty()) {
+        size_t begin = rest.find_first_not_of(" \t\r\n");
+        if (begin == std::string_view::npos) {
+            break;
+        }
+        rest = rest.substr(begin);
+        size_t end = rest.find_first_of(" \t\r\n");
+        std::string_view term = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view() : rest.substr(end);
         
-        if (protocolStr == "vless") {
-            const char* type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-            const char* encryption = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-            const char* security = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
-            
-            VlessNode* vlessNode = new VlessNode(
-                uuid ? uuid : "", 
-                addr ? addr : "", 
-                port, 
-                info ? info : "",
-                type ? type : "tcp",
-                encryption ? encryption : "none",
-                security ? security : "none"
-            );
-            
-            vlessNode->setId(id);
-            node = vlessNode;
-        } else if (protocolStr == "vmess") {
-            const char* type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-            const char* security = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-            const char* tls = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
-            
-            VmessNode* vmessNode = new VmessNode(
-                uuid ? uuid : "", 
-                addr ? addr : "", 
-                port, 
-                info ? info : "",
-                0,  // alterId，默认为0
-                security ? security : "auto",
-                type ? type : "tcp",
-                tls ? tls : ""
-            );
-            
-            vmessNode->setId(id);
-            node = vmessNode;
-        } else if (protocolStr == "trojan") {
-            const char* type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-            const char* sni = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-            
-            TrojanNode* trojanNode = new TrojanNode(
-                uuid ? uuid : "", 
-                addr ? addr : "", 
-                port, 
-                info ? info : "",
-                sni ? sni : addr ? addr : "",
-                type ? type : "tcp"
-            );
-            
-            trojanNode->setId(id);
-            node = trojanNode;
-        } else if (protocolStr == "hy2") {
-            const char* sni = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-            const char* obfs = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-            const char* obfs_password = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
-            
-            Hy2Node* hy2Node = new Hy2Node(
-                uuid ? uuid : "", 
-                addr ? addr : "", 
-                port, 
-                info ? info : "",
-                sni ? sni : addr ? addr : "",
-                obfs ? obfs : "",
-                obfs_password ? obfs_password : "",
-                false  // insecure
-            );
-            
-            hy2Node->setId(id);
-            node = hy2Node;
+        if (hasFullTextIndex && utf8Length(term) >= 3) {
+            if (!match.empty()) {
+                match += " AND ";
+            }
+            match += ftsPhrase(term);
         } else {
-            node = new Node(
-                protocolStr,
-                uuid ? uuid : "",
-                addr ? addr : "",
-                port,
-                info ? info : ""
-            );
-            node->setId(id);
+            likes.push_back(likePattern(term));
         }
-        
-        nodes.push_back(node);
     }
     
-    sqlite3_finalize(stmt);
+    std::string where;
+    if (!match.empty()) {
+        where += " AND id IN (SELECT rowid FROM nodes_fts WHERE nodes_fts MATCH ?)";
+    }
+    for (size_t i = 0; i < likes.size(); i++) {
+        where += " AND (info LIKE ? ESCAPE '\\' OR addr LIKE ? ESCAPE '\\')";
+    }
+    where += nodeConditions(filter);
+    
+    std::string sql = "SELECT " NODE_SUMMARY_COLUMNS " FROM nodes";
+    if (!where.empty()) {
+        sql += " WHERE" + where.substr(4);
+    }
+    sql += nodeOrderClause(filter);
+    sql += ";";
+    
+    sqlite3_stmt* stmt = prepare(sql);
+    if (!stmt) {
+        return false;
+    }
+    
+    int index = 1;
+    if (!match.empty()) {
+        sqlite3_bind_text(stmt, index++, match.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    for (const std::string& pattern : likes) {
+        sqlite3_bind_text(stmt, index++, pattern.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, index++, pattern.c_str(), -1, SQLITE_TRANSIENT);
+    }
+    index = bindNodeFilter(stmt, filter, index);
+    if (filter.limit > 0) {
+        sqlite3_bind_int(stmt, index, filter.limit);
+    }
+    
+    NodeRow row;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        readNodeRow(stmt, NodeProjection::Summary, row);
+        if (!callback(row)) {
+            rc = SQLITE_DONE;
+            break;
+        }
+    }
+    
+    if (rc != SQLITE_DONE) {
+        std::cerr << "搜索节点失败: " << sqlite3_errmsg(db) << std::endl;
+    }
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE;
+}
+
+int DatabaseManager::countNodes(const NodeFilter& filter) {
+    std::string sql = "SELECT COUNT(*) FROM nodes" + nodeWhereClause(filter) + ";";
+    
+    sqlite3_stmt* stmt = prepare(sql);
+    if (!stmt) {
+        return 0;
+    }
+    bindNodeFilter(stmt, filter);
+    
+    int count = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        count = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_reset(stmt);
+    return count;
+}
+
+std::vector<NodeRecord> DatabaseManager::getAllNodes() {
+    return getNodes(NodeFilter());
+}
+
+std::vector<NodeRecord> DatabaseManager::getNodesBySubscribeId(int subscribeId) {
+    NodeFilter filter;
+    filter.subscribeId = subscribeId;
+    return getNodes(filter);
+}
+
+std::optional<NodeRecord> DatabaseManager::getNodeById(int id) {
+    NodeFilter filter;
+    filter.id = id;
+    filter.limit = 1;
+    std::optional<NodeRecord> node;
+    forEachNode(filter, NodeProjection::Full, [&node](const NodeRow& row) {
+        node = nodeFromRow(row);
+        return false;
+    });
+    return node;
+}
+
+std::vector<NodeRecord> DatabaseManager::getNodes(const NodeFilter& filter) {
+    std::vector<NodeRecord> nodes;
+    forEachNode(filter, NodeProjection::Full, [&nodes](const NodeRow& row) {
+        std::optional<NodeRecord> node = nodeFromRow(row);
+        if (node) {
+            nodes.push_back(std::move(*node));
+        }
+        return true;
+    });
     return nodes;
 }
 
-std::vector<Node*> DatabaseManager::getNodesBySubscribeId(int subscribeId) {
-    std::vector<Node*> nodes;
-    const char* sql = "SELECT id, protocol, uuid, addr, port, info, type, encryption, security, extra_params FROM nodes WHERE subscribe_id = ?;";
+std::vector<StoredNodeDigest> DatabaseManager::getNodeDigests(int subscribeId) {
+    std::vector<StoredNodeDigest> digests;
+    const char* sql = "SELECT id, fingerprint, content_hash FROM nodes WHERE subscribe_id = ? ORDER BY id;";
     
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db) << std::endl;
-        return nodes;
+    sqlite3_stmt* stmt = prepare(sql);
+    if (!stmt) {
+        return digests;
     }
     
     sqlite3_bind_int(stmt, 1, subscribeId);
     
     while (sqlite3_step(stmt) == SQLITE_ROW) {
-        int id = sqlite3_column_int(stmt, 0);
-        const char* protocol = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        const char* uuid = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        const char* addr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        int port = sqlite3_column_int(stmt, 4);
-        const char* info = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-        
-        Node* node = nullptr;
-        std::string protocolStr(protocol ? protocol : "");
-        
-        if (protocolStr == "vless") {
-            const char* type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-            const char* encryption = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-            const char* security = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
-            
-            VlessNode* vlessNode = new VlessNode(
-                uuid ? uuid : "", 
-                addr ? addr : "", 
-                port, 
-                info ? info : "",
-                type ? type : "tcp",
-                encryption ? encryption : "none",
-                security ? security : "none"
-            );
-            
-            vlessNode->setId(id);
-            node = vlessNode;
-        } else if (protocolStr == "vmess") {
-            const char* type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-            const char* security = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-            const char* tls = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
-            
-            VmessNode* vmessNode = new VmessNode(
-                uuid ? uuid : "", 
-                addr ? addr : "", 
-                port, 
-                info ? info : "",
-                0,  // alterId，默认为0
-                security ? security : "auto",
-                type ? type : "tcp",
-                tls ? tls : ""
-            );
-            
-            vmessNode->setId(id);
-            node = vmessNode;
-        } else if (protocolStr == "trojan") {
-            const char* type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-            const char* sni = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-            
-            TrojanNode* trojanNode = new TrojanNode(
-                uuid ? uuid : "", 
-                addr ? addr : "", 
-                port, 
-                info ? info : "",
-                sni ? sni : addr ? addr : "",
-                type ? type : "tcp"
-            );
-            
-            trojanNode->setId(id);
-            node = trojanNode;
-        } else if (protocolStr == "hy2") {
-            const char* sni = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-            const char* obfs = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-            const char* obfs_password = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
-            
-            Hy2Node* hy2Node = new Hy2Node(
-                uuid ? uuid : "", 
-                addr ? addr : "", 
-                port, 
-                info ? info : "",
-                sni ? sni : addr ? addr : "",
-                obfs ? obfs : "",
-                obfs_password ? obfs_password : "",
-                false  // insecure
-            );
-            
-            hy2Node->setId(id);
-            node = hy2Node;
-        } else {
-            node = new Node(
-                protocolStr,
-                uuid ? uuid : "",
-                addr ? addr : "",
-                port,
-                info ? info : ""
-            );
-            node->setId(id);
-        }
-        
-        nodes.push_back(node);
+        const char* fingerprint = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        const char* contentHash = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+        digests.push_back({
+            sqlite3_column_int(stmt, 0),
+            fingerprint ? fingerprint : "",
+            contentHash ? contentHash : ""
+        });
     }
     
-    sqlite3_finalize(stmt);
-    return nodes;
+    sqlite3_reset(stmt);
+    return digests;
 }
 
-Node* DatabaseManager::getNodeById(int id) {
-    const char* sql = "SELECT id, protocol, uuid, addr, port, info, type, encryption, security, extra_params FROM nodes WHERE id = ?;";
+int DatabaseManager::countAliases(int subscribeId) {
+    const char* sql = "SELECT COUNT(*) FROM nodes WHERE subscribe_id = ? AND canonical_id IS NOT NULL;";
     
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db) << std::endl;
-        return nullptr;
+    sqlite3_stmt* stmt = prepare(sql);
+    if (!stmt) {
+        return 0;
     }
+    sqlite3_bind_int(stmt, 1, subscribeId);
     
-    sqlite3_bind_int(stmt, 1, id);
-    
+    int count = 0;
     if (sqlite3_step(stmt) == SQLITE_ROW) {
-        int id = sqlite3_column_int(stmt, 0);
-        const char* protocol = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        const char* uuid = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        const char* addr = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        int port = sqlite3_column_int(stmt, 4);
-        const char* info = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-        
-        Node* node = nullptr;
-        std::string protocolStr(protocol ? protocol : "");
-        
-        if (protocolStr == "vless") {
-            const char* type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-            const char* encryption = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-            const char* security = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
-            
-            VlessNode* vlessNode = new VlessNode(
-                uuid ? uuid : "", 
-                addr ? addr : "", 
-                port, 
-                info ? info : "",
-                type ? type : "tcp",
-                encryption ? encryption : "none",
-                security ? security : "none"
-            );
-            
-            vlessNode->setId(id);
-            node = vlessNode;
-        } else if (protocolStr == "vmess") {
-            const char* type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-            const char* security = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-            const char* tls = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
-            
-            VmessNode* vmessNode = new VmessNode(
-                uuid ? uuid : "", 
-                addr ? addr : "", 
-                port, 
-                info ? info : "",
-                0,  // alterId，默认为0
-                security ? security : "auto",
-                type ? type : "tcp",
-                tls ? tls : ""
-            );
-            
-            vmessNode->setId(id);
-            node = vmessNode;
-        } else if (protocolStr == "trojan") {
-            const char* type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-            const char* sni = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-            
-            TrojanNode* trojanNode = new TrojanNode(
-                uuid ? uuid : "", 
-                addr ? addr : "", 
-                port, 
-                info ? info : "",
-                sni ? sni : addr ? addr : "",
-                type ? type : "tcp"
-            );
-            
-            trojanNode->setId(id);
-            node = trojanNode;
-        } else if (protocolStr == "hy2") {
-            const char* sni = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
-            const char* obfs = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
-            const char* obfs_password = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 8));
-            
-            Hy2Node* hy2Node = new Hy2Node(
-                uuid ? uuid : "", 
-                addr ? addr : "", 
-                port, 
-                info ? info : "",
-                sni ? sni : addr ? addr : "",
-                obfs ? obfs : "",
-                obfs_password ? obfs_password : "",
-                false  // insecure
-            );
+        count = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_reset(stmt);
+    return count;
+}
+
+bool DatabaseManager::syncSubscribeNodes(int subscribeId, std::vector<NodeRecord>& nodes, NodeSyncStats& stats) {
+    stats = NodeSyncStats();
+    
+    // 下面任何一步抛出异常(比如内存不够)都会回滚 不会让连接停在事务里
+    TransactionGuard transaction(*this);
+    if (!transaction.begin()) {
+        return false;
+    }
+    
+    // 指纹 -> 数据库里具有这个指纹的节点(按id排序)
+    // 同一个订阅里可能有重复的节点 按先后顺序一一对应
+    std::unordered_map<std::string, std::deque<StoredNodeDigest>> stored;
+    for (auto& digest : getNodeDigests(subscribeId)) {
+        stored[digest.fingerprint].push_back(std::move(digest));
+    }
+    
+    // 先分好类 再每一类用同一条语句批量执行
+    std::vector<NodeRecord*> added;
+    std::vector<const NodeRecord*> changed;
+    for (NodeRecord& record : nodes) {
+        Node& node = record.node();
+        auto it = stored.find(node.getFingerprint());
+        if (it != stored.end() && !it->second.empty()) {
+            StoredNodeDigest digest = std::move(it->second.front());
+            it->second.pop_front();
+            node.setId(digest.id);
             
-            hy2Node->setId(id);
-            node = hy2Node;
+            if (digest.contentHash == node.getContentHash()) {
+                stats.unchanged++;
+            } else {
+                changed.push_back(&record);
+            }
         } else {
-            node = new Node(
-                protocolStr,
-                uuid ? uuid : "",
-                addr ? addr : "",
-                port,
-                info ? info : ""
-            );
-            node->setId(id);
+            added.push_back(&record);
         }
-        
-        sqlite3_finalize(stmt);
-        return node;
     }
     
-    sqlite3_finalize(stmt);
-    return nullptr;
+    // 剩下没有对上的就是订阅里已经消失的节点
+    std::vector<int> removed;
+    for (const auto& entry : stored) {
+        for (const auto& digest : entry.second) {
+            removed.push_back(digest.id);
+        }
+    }
+    
+    if (!removed.empty() || !changed.empty() || !added.empty()) {
+        invalidateCatalog();
+    }
+    
+    bool ok = deleteNodes(removed) && updateNodes(changed) && insertNodes(added, subscribeId);
+    if (!ok) {
+        std::cerr << "同步节点失败: " << sqlite3_errmsg(db) << std::endl;
+        transaction.rollback();
+        stats = NodeSyncStats();
+        return false;
+    }
+    
+    stats.duplicates = countAliases(subscribeId);
+    
+    if (!transaction.commit()) {
+        stats = NodeSyncStats();
+        return false;
+    }
+    stats.added = static_cast<int>(added.size());
+    stats.changed = static_cast<int>(changed.size());
+    stats.removed = static_cast<int>(removed.size());
+    return true;
+}
+
+bool DatabaseManager::updateNodes(const std::vector<const NodeRecord*>& nodes) {
+    if (nodes.empty()) {
+        return true;
+    }
+    
+    sqlite3_stmt* stmt = prepare(kUpdateNodeSql);
+    if (!stmt) {
+        return false;
+    }
+    
+    bool result = true;
+    for (const NodeRecord* node : nodes) {
+        bindNodeFields(stmt, *node, 1);
+        sqlite3_bind_int(stmt, kNodeFieldCount + 1, node->node().getId());
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            result = false;
+            break;
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_reset(stmt);
+    return result;
+}
+
+bool DatabaseManager::deleteNodes(const std::vector<int>& ids) {
+    if (ids.empty()) {
+        return true;
+    }
+    
+    sqlite3_stmt* stmt = prepare(kDeleteNodeSql);
+    if (!stmt) {
+        return false;
+    }
+    
+    bool result = true;
+    for (int id : ids) {
+        sqlite3_bind_int(stmt, 1, id);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            result = false;
+            break;
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_reset(stmt);
+    return result;
+}
+
+std::string DatabaseManager::getCatalogPath() const {
+    return catalogPath;
+}
+
+void DatabaseManager::invalidateCatalog() {
+    // 先删目录再改数据库 读的一方要么用数据库 要么用和数据库一致的目录
+    std::error_code error;
+    fs::remove(catalogPath, error);
+}
+
+bool DatabaseManager::writeCatalog() {
+    NodeCatalog::Writer writer;
+    bool ok = forEachNode(NodeFilter(), NodeProjection::Summary, [&writer](const NodeRow& row) {
+        writer.add(row);
+        return true;
+    });
+    if (!ok || !writer.save(catalogPath)) {
+        std::cerr << "写入节点目录失败: " << catalogPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool DatabaseManager::refreshCatalog() {
+    NodeCatalog catalog(catalogPath);
+    if (catalog.refresh()) {
+        return true;
+    }
+    return writeCatalog();
+}
+
+bool DatabaseManager::beginTransaction() {
+    char* errMsg = nullptr;
+    sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, &errMsg);
+    if (errMsg) {
+        std::cerr << "开始事务失败: " << errMsg << std::endl;
+        sqlite3_free(errMsg);
+        return false;
+    }
+    return true;
+}
+
+bool DatabaseManager::commitTransaction() {
+    char* errMsg = nullptr;
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, &errMsg);
+    if (errMsg) {
+        std::cerr << "提交事务失败: " << errMsg << std::endl;
+        sqlite3_free(errMsg);
+        rollbackTransaction();
+        return false;
+    }
+    return true;
+}
+
+void DatabaseManager::rollbackTransaction() {
+    // 事务可能已经被SQLite自动回滚了 这时ROLLBACK会报错 忽略即可
+    sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
 }
 
 bool DatabaseManager::isTableEmpty(const std::string& tableName) {
     std::string sql = "SELECT COUNT(*) FROM " + tableName + ";";
     
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-        std::cerr << "准备SQL语句失败: " << sqlite3_errmsg(db) << std::endl;
+    sqlite3_stmt* stmt = prepare(sql.c_str());
+    if (!stmt) {
         return true; // 假设为空
     }
     
@@ -674,6 +1256,6 @@ bool DatabaseManager::isTableEmpty(const std::string& tableName) {
         count = sqlite3_column_int(stmt, 0);
     }
     
-    sqlite3_finalize(stmt);
+    sqlite3_reset(stmt);
     return count == 0;
 } 
\ No newline at end of file
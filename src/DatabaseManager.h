@@ -1,20 +1,160 @@
 #ifndef DATABASE_MANAGER_H
 #define DATABASE_MANAGER_H
 
+#include <functional>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <sqlite3.h>
 #include "Subscribe.h"
-#include "Node.h"
-#include "VlessNode.h"
+#include "NodeRecord.h"
+
+// 数据库里已有节点的摘要 订阅同步时用来和新解析出的节点比较
+struct StoredNodeDigest {
+    int id;
+    std::string fingerprint;
+    std::string contentHash;
+};
+
+// forEachNode的过滤条件 各项都是可选的 没设置的不参与过滤
+struct NodeFilter {
+    int id = 0;            // >0时只要这个id的节点
+    int subscribeId = 0;   // >0时只要这个订阅下的节点
+    std::string protocol;  // 非空时只要这个协议的节点
+    std::string security;  // 非空时只要这个安全类型的节点(tls reality等)
+    bool canonicalOnly = false;  // 为true时跳过别名 同一个服务器只出现一次
+    // 分页用 翻页时不用OFFSET 直接从上一页的边界id接着查 只读出这一页
+    int afterId = 0;       // >0时只要id比它大的节点
+    int beforeId = 0;      // >0时只要id比它小的节点 并且按id从大到小返回(往前翻页时取离它最近的)
+    int limit = 0;         // >0时最多返回这么多行
+};
+
+// forEachNode要读出哪些列
+enum class NodeProjection {
+    Summary,  // id subscribe_id protocol addr port info security canonical_id 列表显示用
+    Full,     // 所有列 可以还原成完整的节点对象
+};
+
+// 节点表里的一行 字符串都指向SQLite内部的缓冲区 只在回调期间有效
+// Summary模式下只有前8项有值
+struct NodeRow {
+    int id = 0;
+    int subscribeId = 0;
+    std::string_view protocol;
+    std::string_view addr;
+    int port = 0;
+    std::string_view info;
+    std::string_view security;
+    int canonicalId = 0;  // 别名指向的正本 本身就是正本时为0
+    std::string_view uuid;
+    std::string_view type;
+    std::string_view encryption;
+    std::string_view sni;
+    std::string_view host;
+    std::string_view path;
+    std::string_view serviceName;
+    std::string_view flow;
+    std::string_view tlsFingerprint;
+    std::string_view publicKey;
+    std::string_view shortId;
+    std::string_view alpn;
+    std::string_view obfs;
+    std::string_view obfsPassword;
+    int alterId = 0;
+    bool insecure = false;
+    std::string_view extraParams;  // 其余参数 JSON对象
+};
+
+// 一次订阅同步的结果统计
+struct NodeSyncStats {
+    int added = 0;      // 新增的节点
+    int changed = 0;    // 指纹相同但内容有变化 原地更新的节点
+    int removed = 0;    // 订阅里已经没有 被删除的节点
+    int unchanged = 0;  // 完全没变的节点
+    int duplicates = 0; // 同步后这个订阅里有多少节点和别的节点重复 只作为别名保存
+};
 
 class DatabaseManager {
 private:
+    // 当前的表结构版本 存在PRAGMA user_version里 改表结构时加一并补上对应的migrateToVersionN
+    static const int kSchemaVersion = 4;
+    // 数据库被其他连接锁住时最多等多久
+    static const int kBusyTimeoutMs = 5000;
+
     sqlite3* db;
     std::string dbPath;
+    // 节点目录 和数据库放在一起 扩展名是.catalog
+    std::string catalogPath;
+    // 有没有nodes_fts全文索引表 SQLite没编译FTS5时没有 搜索退回LIKE
+    bool hasFullTextIndex = false;
+
+    // 编译好的语句 SQL文本 -> 语句 连接关闭前一直复用
+    std::unordered_map<std::string, sqlite3_stmt*> statements;
+
+    // 取得sql对应的语句 第一次用时编译并缓存 以后只做重置和清空绑定
+    // 语句用完后要sqlite3_reset 不要finalize 失败时返回nullptr
+    sqlite3_stmt* prepare(const std::string& sql);
 
-    // 初始化数据库表结构
-    void initDatabase();
+    // 按版本号检查表结构 版本已经是最新时什么都不做
+    // 升级失败时整个回滚 版本号不变 返回false 下次打开时重新升级
+    bool initDatabase();
+    int getSchemaVersion();
+    bool migrateToVersion1();
+    bool migrateToVersion2();
+    bool migrateToVersion3();
+    bool migrateToVersion4();
+
+    // 执行sql 失败时打印"what: 错误信息"并返回false
+    bool exec(const char* sql, const char* what);
+
+    // 自己开的事务 离开作用域时还没提交就回滚 中途抛出异常也一样
+    // 不回滚的话连接一直占着写锁 这个连接后面的事务全都开不了
+    class TransactionGuard {
+       public:
+        explicit TransactionGuard(DatabaseManager& manager) : manager(manager) {}
+        ~TransactionGuard() { rollback(); }
+        TransactionGuard(const TransactionGuard&) = delete;
+        TransactionGuard& operator=(const TransactionGuard&) = delete;
+
+        bool begin() {
+            active = manager.beginTransaction();
+            return active;
+        }
+        // 提交失败时commitTransaction已经回滚过了
+        bool commit() {
+            active = false;
+            return manager.commitTransaction();
+        }
+        void rollback() {
+            if (active) {
+                active = false;
+                manager.rollbackTransaction();
+            }
+        }
+
+       private:
+        DatabaseManager& manager;
+        bool active = false;
+    };
+
+    // 给旧版本创建的表补上新加的列
+    bool addColumnIfMissing(const std::string& table, const std::string& column,
+                            const std::string& definition);
+
+    // 批量插入/更新/删除节点 整批只编译一次语句 要在事务里调用
+    // 传指针是因为同步时只处理数组里的一部分节点 插入成功后会设置节点的id
+    bool insertNodes(const std::vector<NodeRecord*>& nodes, int subscribeId);
+    bool updateNodes(const std::vector<const NodeRecord*>& nodes);
+    bool deleteNodes(const std::vector<int>& ids);
+    
+    // 订阅里作为别名保存的节点数
+    int countAliases(int subscribeId);
+    
+    // 节点要变了 删掉节点目录 改节点的方法在动数据库之前都要调用
+    void invalidateCatalog();
 
 public:
     // 构造函数
@@ -32,18 +172,60 @@ public:
     // 订阅相关操作
     bool addSubscribe(const Subscribe& subscribe);
     bool updateSubscribe(const Subscribe& subscribe);
+    // 只更新条件请求用的ETag/Last-Modified和内容哈希
+    bool updateSubscribeCache(const Subscribe& subscribe);
     bool deleteSubscribe(int id);
     std::vector<Subscribe> getAllSubscribes();
     Subscribe getSubscribeById(int id);
 
     // 节点相关操作
-    bool addNode(Node* node, int subscribeId);
-    bool updateNode(Node* node);
+    // 已经有指纹相同的节点时 新节点作为它的别名保存 见NodeFilter::canonicalOnly
+    bool addNode(NodeRecord& node, int subscribeId);
+    // 批量插入节点 整批只编译一次语句 在同一个事务里完成(已经在事务里时直接并入)
+    // 成功时每个节点的id都会被设置成新id 失败时整批都不会写入
+    bool addNodes(std::vector<NodeRecord>& nodes, int subscribeId);
+    // 按id整行更新 不能改变节点的指纹(正本和别名的关系是按指纹建立的)
+    bool updateNode(const NodeRecord& node);
     bool deleteNode(int id);
     bool deleteAllNodesInSubscribe(int subscribeId);
-    std::vector<Node*> getAllNodes();
-    std::vector<Node*> getNodesBySubscribeId(int subscribeId);
-    Node* getNodeById(int id);
+    std::vector<NodeRecord> getAllNodes();
+    std::vector<NodeRecord> getNodesBySubscribeId(int subscribeId);
+    // 没有这个id的节点时返回空
+    std::optional<NodeRecord> getNodeById(int id);
+    // 把符合条件的节点读出来还原成节点对象
+    std::vector<NodeRecord> getNodes(const NodeFilter& filter);
+
+    // 按id顺序逐行读取符合条件的节点 不创建节点对象 回调返回false时提前结束
+    // 回调里可以调用其他方法 但不要再用同样的条件调用forEachNode(会共用同一条语句)
+    // 读到最后或者被回调中止时返回true 出错时返回false
+    bool forEachNode(const NodeFilter& filter, NodeProjection projection,
+                     const std::function<bool(const NodeRow&)>& callback);
+    // 符合条件的节点数 不看limit
+    int countNodes(const NodeFilter& filter);
+    // 在别名和地址里搜索 query按空白分成几个词 每个词都要出现(不区分大小写)
+    // 其他条件和forEachNode一样 结果按id顺序以Summary的列交给回调
+    // 3个字符以上的词走全文索引 更短的词只能逐行LIKE
+    bool searchNodes(const std::string& query, const NodeFilter& filter,
+                     const std::function<bool(const NodeRow&)>& callback);
+    
+    // 取得某个订阅下所有节点的指纹和内容哈希 按id排序
+    std::vector<StoredNodeDigest> getNodeDigests(int subscribeId);
+    // 把订阅下的节点同步成nodes 在一个事务里完成
+    // 只插入新增的 更新变化的 删除消失的 没变的节点保留原来的id
+    // 成功时nodes里每个节点的id都会被设置好
+    bool syncSubscribeNodes(int subscribeId, std::vector<NodeRecord>& nodes, NodeSyncStats& stats);
+
+    // 节点目录(见NodeCatalog) 只读的一方可以不打开数据库
+    std::string getCatalogPath() const;
+    // 按数据库现在的内容重写节点目录
+    bool writeCatalog();
+    // 节点目录不存在(节点有变化后被删掉了)或者格式旧了才重写
+    bool refreshCatalog();
+
+    // 事务
+    bool beginTransaction();
+    bool commitTransaction();
+    void rollbackTransaction();
     
     // 其他辅助方法
     bool isTableEmpty(const std::string& tableName);
@@ -1,152 +1,110 @@
 #include "Hy2Node.h"
-#include <iostream>
-#include <regex>
-#include <sstream>
+#include "ProtocolTraits.h"
 #include <nlohmann/json.hpp>
 #include "base64.h"
+#include "share_link.h"
 #include <fstream>
 #include <filesystem>
 
 namespace fs = std::filesystem;
 using json = nlohmann::json;
 
-Hy2Node::Hy2Node(std::string uuid, std::string addr, int port, std::string info,
-                 std::string sni, std::string obfs, std::string obfs_password, bool insecure)
-    : Node("hy2", uuid, addr, port, info), 
-      sni(sni),
-      obfs(obfs),
-      obfs_password(obfs_password),
+Hy2Node::Hy2Node(std::string_view uuid, std::string_view addr, int port, std::string_view info,
+                 std::string_view sni, std::string_view obfs, std::string_view obfs_password, bool insecure)
+    : Node(ProtocolTraits<Hy2Node>::name, uuid, addr, port, info), 
       insecure(insecure) {
+    setObfs(obfs);
+    setSni(sni);
+    setObfsPassword(obfs_password);
 }
 
-Hy2Node* Hy2Node::parseFromUrl(const std::string& url) {
+std::optional<Hy2Node> Hy2Node::parseFromUrl(std::string_view url) {
     // hysteria2://uuid@host:port?insecure=1&sni=example.com&obfs=salamander&obfs-password=123456#info
-    std::regex hy2Regex(R"(hysteria2://([^@]+)@([^:]+):(\d+)\??([^#]*)(?:#(.*))?)", std::regex::ECMAScript);
-    std::smatch match;
-
-    if (!std::regex_match(url, match, hy2Regex)) {
-        std::cerr << "无法解析节点: " << url.substr(0, 50) << "..." << std::endl;
-        return nullptr;
+    // hy2://是同一个协议的简写
+    ShareLink link;
+    if (!parseShareLink(url, link) || (!schemeIs(link, "hysteria2") && !schemeIs(link, "hy2"))) {
+        return std::nullopt;
     }
 
-    std::string uuid = match[1].str();
-    std::string addr = match[2].str();
-    int port = std::stoi(match[3].str());
-    std::string params = match[4].str();
-    std::string info = match[5].str();
-
-    // URL解码info (处理中文和特殊字符)
-    info = urlDecode(info);
-
-    // 默认设置
-    std::string sni = addr; // 默认使用地址作为SNI
-    std::string obfs = "";
-    std::string obfs_password = "";
-    bool insecure = false;
-
-    // 解析参数
-    if (!params.empty()) {
-        std::stringstream ss(params);
-        std::string param;
-
-        while (std::getline(ss, param, '&')) {
-            size_t pos = param.find('=');
-            if (pos != std::string::npos) {
-                std::string key = param.substr(0, pos);
-                std::string value = param.substr(pos + 1);
-                
-                // URL解码参数值
-                value = urlDecode(value);
-
-                if (key == "sni") {
-                    sni = value;
-                } else if (key == "obfs") {
-                    obfs = value;
-                } else if (key == "obfs-password") {
-                    obfs_password = value;
-                } else if (key == "insecure") {
-                    insecure = (value == "1" || value == "true");
-                }
-            }
+    // 默认使用地址作为SNI
+    std::string_view addr = link.host;
+    Hy2Node node(link.userinfo, addr, link.port, percentDecode(link.fragment), addr);
+
+    forEachQueryParam(link.query, [&node](QueryKey key, std::string_view name, std::string_view raw) {
+        std::string value = percentDecode(raw);
+        switch (key) {
+            case QueryKey::Sni: node.setSni(value); break;
+            case QueryKey::Obfs: node.setObfs(value); break;
+            case QueryKey::ObfsPassword: node.setObfsPassword(value); break;
+            case QueryKey::Insecure: node.setInsecure(value == "1" || value == "true"); break;
+            default: node.setExtraParam(name, value); break;
         }
-    }
+    });
 
-    // 创建节点
-    Hy2Node* node = new Hy2Node(uuid, addr, port, info, sni, obfs, obfs_password, insecure);
     return node;
 }
 
-// URL解码函数
-std::string Hy2Node::urlDecode(const std::string& encoded) {
-    std::string result;
-    char ch;
-    int i, len = encoded.length();
-    
-    for (i = 0; i < len; i++) {
-        if (encoded[i] == '%') {
-            if (i + 2 < len) {
-                std::string hex = encoded.substr(i + 1, 2);
-                int value = 0;
-                std::istringstream(hex) >> std::hex >> value;
-                ch = static_cast<char>(value);
-                result += ch;
-                i += 2;
-            }
-        } else if (encoded[i] == '+') {
-            result += ' ';
-        } else {
-            result += encoded[i];
-        }
-    }
-    
-    return result;
-}
-
-std::string Hy2Node::getSni() const {
-    return sni;
+std::string_view Hy2Node::getSni() const {
+    std::string_view value = getOwnText(kSni);
+    return value.empty() ? getAddr() : value;
 }
 
-std::string Hy2Node::getObfs() const {
-    return obfs;
+std::string_view Hy2Node::getObfs() const {
+    return getToken(obfs, kObfsToken);
 }
 
-std::string Hy2Node::getObfsPassword() const {
-    return obfs_password;
+std::string_view Hy2Node::getObfsPassword() const {
+    return getOwnText(kObfsPassword);
 }
 
 bool Hy2Node::getInsecure() const {
     return insecure;
 }
 
-std::string Hy2Node::getExtraParam(const std::string& key) const {
-    auto it = extra_params.find(key);
-    if (it != extra_params.end()) {
-        return it->second;
-    }
-    return "";
+std::string_view Hy2Node::getExtraParam(std::string_view key) const {
+    return extra_params.get(key);
+}
+
+const ParamList& Hy2Node::getExtraParams() const {
+    return extra_params;
 }
 
-void Hy2Node::setSni(const std::string& sni) {
-    this->sni = sni;
+void Hy2Node::setSni(std::string_view sni) {
+    // 大多数节点的SNI就是自己的地址 这时不存
+    setOwnText(kSni, sni == getAddr() ? std::string_view() : sni);
 }
 
-void Hy2Node::setObfs(const std::string& obfs) {
-    this->obfs = obfs;
+void Hy2Node::setObfs(std::string_view obfs) {
+    setToken(this->obfs, kObfsToken, obfs);
 }
 
-void Hy2Node::setObfsPassword(const std::string& obfs_password) {
-    this->obfs_password = obfs_password;
+void Hy2Node::setObfsPassword(std::string_view obfs_password) {
+    setOwnText(kObfsPassword, obfs_password);
 }
 
 void Hy2Node::setInsecure(bool insecure) {
     this->insecure = insecure;
 }
 
-void Hy2Node::setExtraParam(const std::string& key, const std::string& value) {
-    extra_params[key] = value;
+void Hy2Node::setExtraParam(std::string_view key, std::string_view value) {
+    extra_params.set(key, value);
+}
+
+void Hy2Node::appendIdentity(std::string& out) const {
+    appendField(out, getToken(obfs, kObfsToken));
 }
 
-std::string Hy2Node::toXrayConfig() const {
+void Hy2Node::appendDetails(std::string& out) const {
+    appendField(out, getSni());
+    appendField(out, getObfsPassword());
+    appendField(out, insecure ? "1" : "0");
+    for (const auto& param : extra_params) {
+        appendField(out, param.key);
+        appendField(out, param.value);
+    }
+}
+
+void Hy2Node::toXrayConfig(json& outbound) const {
     // 生成Hysteria2配置文件
     std::string home = std::getenv("HOME") ? std::getenv("HOME") : ".";
     std::string configDir = home + "/.heresy/";
@@ -187,7 +145,7 @@ std::string Hy2Node::toXrayConfig() const {
     }
     
     // 使用XRay的出站规则连接到Hysteria2的本地端口
-    json outbound = {
+    outbound = {
         {"protocol", "http"},
         {"settings", {
             {"servers", json::array({
@@ -199,6 +157,4 @@ std::string Hy2Node::toXrayConfig() const {
         }},
         {"tag", "proxy"}
     };
-    
-    return outbound.dump(4);
 } 
\ No newline at end of file
@@ -2,7 +2,10 @@
 #define HY2NODE_H
 #include "Node.h"
 #include <string>
-#include <map>
+#include <string_view>
+#include "ParamList.h"
+#include <optional>
+#include <nlohmann/json_fwd.hpp>
 
 /* hysteria2协议的节点的实体类
  * 父类Node已有以下几个属性...
@@ -16,41 +19,47 @@
 class Hy2Node : public Node {
    private:
     // Hysteria2特有的字段
-    std::string sni;
-    std::string obfs;  // 混淆密码
-    std::string obfs_password;
+    InternedString obfs;  // 混淆方式 比如salamander
+    // 存在Node的文字里的段号: 不认识的obfs 每个节点自己的sni(和地址一样时不存)和混淆密码
+    enum OwnText { kObfsToken, kSni, kObfsPassword };
     bool insecure;  // 是否跳过证书验证
 
     // 额外参数
-    std::map<std::string, std::string> extra_params;
-
-    // URL解码工具函数
-    static std::string urlDecode(const std::string& encoded);
+    ParamList extra_params;
 
    public:
     // 构造函数
-    Hy2Node(std::string uuid, std::string addr, int port, std::string info,
-           std::string sni = "", std::string obfs = "", std::string obfs_password = "", 
+    Hy2Node(std::string_view uuid, std::string_view addr, int port, std::string_view info,
+           std::string_view sni = "", std::string_view obfs = "", std::string_view obfs_password = "", 
            bool insecure = false);
 
-    // 从URL解析Hy2Node
-    static Hy2Node* parseFromUrl(const std::string& url);
+    // 从URL解析Hy2Node 格式不对时返回空
+    // 不输出任何信息 可能在解析线程里被调用 失败由调用方统一报告
+    static std::optional<Hy2Node> parseFromUrl(std::string_view url);
 
     // Getter和Setter
-    std::string getSni() const;
-    std::string getObfs() const;
-    std::string getObfsPassword() const;
+    std::string_view getSni() const;
+    std::string_view getObfs() const;
+    std::string_view getObfsPassword() const;
     bool getInsecure() const;
-    std::string getExtraParam(const std::string& key) const;
+    std::string_view getExtraParam(std::string_view key) const;
+    // 全部额外参数 存数据库时用
+    const ParamList& getExtraParams() const;
 
-    void setSni(const std::string& sni);
-    void setObfs(const std::string& obfs);
-    void setObfsPassword(const std::string& obfs_password);
+    void setSni(std::string_view sni);
+    void setObfs(std::string_view obfs);
+    void setObfsPassword(std::string_view obfs_password);
     void setInsecure(bool insecure);
-    void setExtraParam(const std::string& key, const std::string& value);
+    void setExtraParam(std::string_view key, std::string_view value);
 
     // 生成Xray配置的JSON片段（实际使用Http代理到Hysteria2）
-    std::string toXrayConfig() const;
+    // 直接写进调用方配置树里的outbound 不再先转成字符串
+    void toXrayConfig(nlohmann::json& outbound) const;
+
+   protected:
+    // 参与指纹和内容哈希计算的参数
+    void appendIdentity(std::string& out) const override;
+    void appendDetails(std::string& out) const override;
 };
 
 #endif 
\ No newline at end of file
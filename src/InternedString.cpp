@@ -0,0 +1,139 @@
+#include "InternedString.h"
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+// 订阅链接里常见的参数名和取值 启动时先放进池子 之后只读
+// 链接里的其他写法都不驻留 一个订阅再怎么乱写池子也不会变大
+const char* const kVocabulary[] = {
+    // 协议
+    "vless", "vmess", "trojan", "hy2", "hysteria2",
+    // 参数名
+    "type", "security", "encryption", "flow", "sni", "alpn", "fp", "pbk", "sid", "spx", "path", "host",
+    "serviceName", "mode", "headerType", "seed", "authority", "extra", "allowInsecure", "insecure", "peer",
+    "obfs", "obfs-password", "pinSHA256", "mport", "up", "down", "quicSecurity", "key", "packetEncoding",
+    // 传输方式
+    "tcp", "kcp", "mkcp", "ws", "http", "h2", "grpc", "quic", "httpupgrade", "xhttp", "splithttp",
+    // 安全类型 加密方式 混淆
+    "none", "tls", "reality", "xtls", "auto", "zero", "aes-128-gcm", "chacha20-poly1305", "salamander",
+    // 指纹
+    "chrome", "firefox", "safari", "ios", "android", "edge", "360", "qq", "random", "randomized",
+    // alpn
+    "h3", "http/1.1", "h2,http/1.1", "h3,h2,http/1.1", "h3,h2",
+    // 其他常见的取值
+    "xtls-rprx-vision", "xtls-rprx-vision-udp443", "gun", "multi", "packet-up", "stream-up", "stream-one",
+    "0", "1", "true", "false",
+};
+
+// 编号 -> 字符串 分块存放 块一旦分配就不再移动
+// 读的时候不加锁: 拿到编号的线程一定能看到它对应的字符串(写入在发出编号之前 都在锁里)
+class StringPool {
+   public:
+    static StringPool& instance() {
+        static StringPool pool;
+        return pool;
+    }
+
+    StringPool() {
+        for (const char* text : kVocabulary) {
+            intern(text);
+        }
+        vocabularyEnd = next;
+    }
+
+    // 词表里的编号在前面 池子后来加的都不算
+    uint32_t find(std::string_view text) {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = index.find(text);
+        return it != index.end() && it->second < vocabularyEnd ? it->second : 0;
+    }
+
+    uint32_t intern(std::string_view text) {
+        if (text.empty()) {
+            return 0;
+        }
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto it = index.find(text);
+            if (it != index.end()) {
+                return it->second;
+            }
+        }
+
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        auto it = index.find(text);
+        if (it != index.end()) {
+            return it->second;
+        }
+        if (next >= kChunkSize * kMaxChunks) {
+            throw std::length_error("驻留字符串太多了");
+        }
+        size_t chunk = next / kChunkSize;
+        std::string* slots = chunks[chunk].load(std::memory_order_relaxed);
+        if (!slots) {
+            slots = new std::string[kChunkSize];
+            chunks[chunk].store(slots, std::memory_order_release);
+        }
+        std::string& slot = slots[next % kChunkSize];
+        slot.assign(text.data(), text.size());
+        // 键指向池子里的那一份 不再额外复制
+        index.emplace(std::string_view(slot), next);
+        bytes += text.size();
+        return next++;
+    }
+
+    const std::string& get(uint32_t id) const {
+        static const std::string empty;
+        if (id == 0) {
+            return empty;
+        }
+        return chunks[id / kChunkSize].load(std::memory_order_acquire)[id % kChunkSize];
+    }
+
+    size_t size() {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return next - 1;
+    }
+
+    size_t byteCount() {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return bytes;
+    }
+
+   private:
+    static const size_t kChunkSize = 4096;
+    static const size_t kMaxChunks = 4096;  // 最多一千六百多万个不同的字符串
+
+    std::shared_mutex mutex;
+    std::unordered_map<std::string_view, uint32_t> index;
+    std::atomic<std::string*> chunks[kMaxChunks] = {};
+    uint32_t next = 1;  // 0留给空字符串
+    uint32_t vocabularyEnd = 1;
+    size_t bytes = 0;
+};
+
+}  // namespace
+
+InternedString::InternedString(std::string_view text) : id(StringPool::instance().intern(text)) {}
+
+InternedString InternedString::known(std::string_view text) {
+    InternedString result;
+    result.id = StringPool::instance().find(text);
+    return result;
+}
+
+const std::string& InternedString::str() const {
+    return StringPool::instance().get(id);
+}
+
+size_t InternedString::poolSize() {
+    return StringPool::instance().size();
+}
+
+size_t InternedString::poolBytes() {
+    return StringPool::instance().byteCount();
+}
@@ -0,0 +1,48 @@
+#ifndef INTERNEDSTRING_H
+#define INTERNEDSTRING_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*
+ * 驻留字符串 同样的内容在整个进程里只存一份 对象本身只是一个4字节的编号
+ * 只给取值种类很少的字段用: 协议名 传输方式 安全类型 混淆方式 额外参数的键...
+ * 十万个节点里"tcp" "reality"还是只存一次 比较相等只要比编号
+ *
+ * 池子只增不减 不要拿来存每个节点都可能不一样的东西(别名 地址 密码 sni path pbk...)
+ * 那些放在NodeText或者ParamList里 跟着节点一起释放 不然每刷新一次订阅池子就大一圈
+ * 订阅链接里来的键和值也一样 什么都可能写 只能用known()在固定的词表里找
+ * 可以在多个解析线程里同时创建和读取
+ */
+class InternedString {
+   public:
+    // 空字符串 编号为0
+    InternedString() = default;
+    // 不在池子里就加进去 只给代码里写死的字符串用(协议名)
+    explicit InternedString(std::string_view text);
+
+    // 只在固定的词表里找(常见的参数名 传输方式 安全类型 指纹 alpn...) 不认识返回空 池子不会变大
+    // 不认识的由调用方存在节点自己的内存里
+    static InternedString known(std::string_view text);
+
+    // 池子里的那一份 一直有效
+    const std::string& str() const;
+    std::string_view view() const { return str(); }
+    bool empty() const { return id == 0; }
+
+    friend bool operator==(InternedString a, InternedString b) { return a.id == b.id; }
+    friend bool operator!=(InternedString a, InternedString b) { return a.id != b.id; }
+
+    // 池子里一共有多少个不同的字符串 占了多少字节 测内存时用
+    static size_t poolSize();
+    static size_t poolBytes();
+
+   private:
+    // ParamList的一项里要把编号和别的标记挤在一起
+    friend class ParamList;
+
+    uint32_t id = 0;
+};
+
+#endif
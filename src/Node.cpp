@@ -1,46 +1,169 @@
 #include "Node.h"
 #include <string>
+#include "hash_util.h"
 
 // 构造函数
 // 这里没有id这个参数 从url文本处理产生的节点信息没有这个属性
 // 而来自数据库的节点数据则有这个属性 所以构造函数默认是不填入这个参数的
 // 来自数据库的节点信息创建的节点对象就再调用一下setId()来把这个数据塞进去...反正这些都是存放在数据库中的
 // 这个类(及它的子类)所创建的对象只不过是运送数据的桥梁罢了
-Node::Node(std::string protocol, std::string uuid, std::string addr, int port,
-           std::string info)
-    : protocol(protocol), uuid(uuid), addr(addr), port(port), info(info) {}
+Node::Node(std::string_view protocol, std::string_view uuid, std::string_view addr, int port,
+           std::string_view info)
+    : port(static_cast<uint16_t>(port)), protocol(protocol), text({addr, info}) {
+    storeUuid(uuid);
+}
+
+namespace {
+
+const char kHexDigits[] = "0123456789abcdef";
+
+// 小写十六进制字符的值 其他字符返回-1 大写的不算(压缩后还原不回原样)
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+// 标准uuid里连字符的位置
+bool isDashPosition(size_t i) {
+    return i == 8 || i == 13 || i == 18 || i == 23;
+}
+
+}  // namespace
+
+void Node::storeUuid(std::string_view uuid) {
+    uuidPacked = false;
+    if (uuid.size() == 36) {
+        size_t byte = 0;
+        bool valid = true;
+        for (size_t i = 0; i < uuid.size() && valid; i++) {
+            if (isDashPosition(i)) {
+                valid = uuid[i] == '-';
+                continue;
+            }
+            int high = hexValue(uuid[i]);
+            int low = hexValue(uuid[i + 1]);
+            valid = high >= 0 && low >= 0;
+            uuidBytes[byte++] = static_cast<uint8_t>((high << 4) | low);
+            i++;
+        }
+        if (valid) {
+            uuidPacked = true;
+            if (!text.get(kUuid).empty()) {
+                text.set(kUuid, std::string_view());
+            }
+            return;
+        }
+    }
+    text.set(kUuid, uuid);
+}
 
 //getter和setter
     int Node::getId(void) const {
         return id;
     }
-    std::string Node::getProtocol(void) const {
-        return protocol;
+    std::string_view Node::getProtocol(void) const {
+        return protocol.view();
+    }
+    void Node::appendUuid(std::string& out) const {
+        if (!uuidPacked) {
+            out += text.get(kUuid);
+            return;
+        }
+        for (size_t byte = 0; byte < uuidBytes.size(); byte++) {
+            if (byte == 4 || byte == 6 || byte == 8 || byte == 10) {
+                out.push_back('-');
+            }
+            out.push_back(kHexDigits[uuidBytes[byte] >> 4]);
+            out.push_back(kHexDigits[uuidBytes[byte] & 0xf]);
+        }
     }
     std::string Node::getUuid(void) const {
+        std::string uuid;
+        appendUuid(uuid);
         return uuid;
     }
-    std::string Node::getAddr(void) const {
-        return addr;
+    std::string_view Node::getAddr(void) const {
+        return text.get(kAddr);
     }
     int Node::getPort(void) const {
         return port;
     }
-    std::string Node::getInfo(void) const {
-        return info;
+    std::string_view Node::getInfo(void) const {
+        return text.get(kInfo);
     }
     void Node::setId(int id){
         this->id = id;
     }
-    void Node::setProtocol(std::string protocol){
-        this->protocol = protocol;
+    void Node::setProtocol(std::string_view protocol){
+        this->protocol = InternedString(protocol);
     }
-    void Node::setAddr(std::string addr){
-        this->addr = addr;
+    void Node::setAddr(std::string_view addr){
+        text.set(kAddr, addr);
     }
     void Node::setPort(int port){
-        this->port = port;
+        this->port = static_cast<uint16_t>(port);
+    }
+    void Node::setInfo(std::string_view info){
+        text.set(kInfo, info);
+    }
+
+    std::string_view Node::getOwnText(size_t slot) const {
+        return text.get(kFirstOwn + slot);
+    }
+    void Node::setOwnText(size_t slot, std::string_view value){
+        // 两边都是空的时候不动 不然会白白分配一块
+        if (!value.empty() || !text.get(kFirstOwn + slot).empty()) {
+            text.set(kFirstOwn + slot, value);
+        }
+    }
+    void Node::setToken(InternedString& token, size_t slot, std::string_view value){
+        token = InternedString::known(value);
+        setOwnText(slot, token.empty() ? value : std::string_view());
+    }
+    std::string_view Node::getToken(InternedString token, size_t slot) const {
+        return token.empty() ? getOwnText(slot) : token.view();
+    }
+
+    std::string Node::getFingerprint(void) const {
+        std::string key;
+        key.reserve(128);
+        appendField(key, protocol.view());
+        appendUuid(key);
+        key += '\x1f';
+        // 域名不区分大小写 不同机场写法不一样也要算同一个服务器
+        for (char c : getAddr()) {
+            key.push_back((c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c);
+        }
+        key += '\x1f';
+        appendField(key, std::to_string(port));
+        appendIdentity(key);
+        return hashHex(key);
+    }
+    std::string Node::getContentHash(void) const {
+        std::string content;
+        content.reserve(256);
+        appendField(content, protocol.view());
+        appendUuid(content);
+        content += '\x1f';
+        appendField(content, getAddr());
+        appendField(content, std::to_string(port));
+        appendIdentity(content);
+        appendField(content, getInfo());
+        appendDetails(content);
+        return hashHex(content);
+    }
+    void Node::appendIdentity(std::string& /*out*/) const {
+        // 基类没有传输参数
+    }
+    void Node::appendDetails(std::string& /*out*/) const {
+        // 基类没有其余参数
     }
-    void Node::setInfo(std::string info){
-        this->info = info;
+    void Node::appendField(std::string& out, std::string_view value) {
+        out += value;
+        out += '\x1f';
     }
@@ -1,6 +1,11 @@
 #ifndef NODE_H
 #define NODE_H
+#include <array>
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include "InternedString.h"
+#include "NodeText.h"
 // 节点信息 与机场提供的链接相对应上
 // 这个是抽象类 不能实体化的...各协议的节点信息都有不同的地方
 // 这个类只是抽象出了他们共有的属性
@@ -8,28 +13,72 @@
 // 每个协议的url内容都不一样 到时候再处理好了 太难了aaa
 class Node {
    private:
-    int id;  // 数据库的主键 在构造函数中可选 用于与数据库对接
-    std::string protocol;  // 协议
-    std::string uuid;      // 用户uuid
-    std::string addr;      // 地址(ip 域名)
-    int port;              // 端口
-    std::string info;  // 描述 像"美国凤凰城2-vless"这样的文字信息
+    int id = 0;  // 数据库的主键 在构造函数中可选 用于与数据库对接
+    uint16_t port;         // 端口
+    // uuid是标准的小写格式(8-4-4-4-12)时只存16个字节 放在uuidBytes里
+    // 其他写法和trojan hy2的密码原样存在text里
+    bool uuidPacked = false;
+    InternedString protocol;  // 协议
+    std::array<uint8_t, 16> uuidBytes{};
+    // 地址(ip 域名) 描述(像"美国凤凰城2-vless"这样的文字信息)和没压缩的uuid 合在一块内存里
+    // 后面几段给子类用(sni 混淆密码 不在驻留词表里的传输方式...) NodeText最多六段 所以子类最多三段
+    // 全都放在同一块内存里 一个节点只有这一块文字
+    enum TextField { kAddr, kInfo, kUuid, kFirstOwn };
+    NodeText text;
+
+    // 设置uuid 能压成16个字节就压
+    void storeUuid(std::string_view uuid);
+    // 把uuid的文字追加到out里
+    void appendUuid(std::string& out) const;
    public:
     //构造函数
-    Node(std::string protocol, std::string uuid, std::string addr, int port,
-         std::string info);
+    // 文字都要复制进驻留池或者NodeText 所以参数只是视图 调用方的字符串不会被拿走
+    // 只有协议名进驻留池 其余的每个节点都可能不一样
+    Node(std::string_view protocol, std::string_view uuid, std::string_view addr, int port,
+         std::string_view info);
+    virtual ~Node() = default;
+    // 声明了虚析构函数 编译器就不会自动生成移动操作了 不写的话放进vector和optional时都是复制
+    Node(const Node&) = default;
+    Node(Node&&) noexcept = default;
+    Node& operator=(const Node&) = default;
+    Node& operator=(Node&&) noexcept = default;
 
     // getter和setter
+    // 返回的视图指向节点自己的数据(或者驻留池) 节点被修改或销毁之前一直有效 不复制
     int getId(void) const;
-    std::string getProtocol(void) const;
+    std::string_view getProtocol(void) const;
+    // uuid可能是压成16个字节存的 只能现拼出来
     std::string getUuid(void) const;
-    std::string getAddr(void) const;
+    std::string_view getAddr(void) const;
     int getPort(void) const;
-    std::string getInfo(void) const;
+    std::string_view getInfo(void) const;
     void setId(int id);
-    void setProtocol(std::string protocol);
-    void setAddr(std::string addr);
+    void setProtocol(std::string_view protocol);
+    void setAddr(std::string_view addr);
     void setPort(int port);
-    void setInfo(std::string info);
+    void setInfo(std::string_view info);
+
+    // 节点指纹: 协议+uuid+地址+端口再加上传输参数的哈希
+    // 订阅更新时指纹相同就认为是同一个节点 保留它在数据库里的id
+    // 不同订阅里指纹相同的节点是同一个服务器 数据库里只有一个正本 其余是别名
+    std::string getFingerprint(void) const;
+    // 节点全部内容(包括别名)的哈希 指纹相同而内容哈希不同 说明节点被修改过
+    std::string getContentHash(void) const;
+
+   protected:
+    // 子类自己的第slot段文字 slot从0开始
+    std::string_view getOwnText(size_t slot) const;
+    void setOwnText(size_t slot, std::string_view value);
+    // 传输方式 安全类型 混淆方式这类字段: 认识的值驻留 不认识的放进子类自己的第slot段文字
+    // 链接里什么都可能写 全都驻留的话池子只增不减
+    void setToken(InternedString& token, size_t slot, std::string_view value);
+    std::string_view getToken(InternedString token, size_t slot) const;
+
+    // 子类把决定"是不是同一个节点"的传输参数追加到out里
+    virtual void appendIdentity(std::string& out) const;
+    // 子类把其余的参数追加到out里
+    virtual void appendDetails(std::string& out) const;
+    // 用不会出现在链接里的分隔符拼接字段
+    static void appendField(std::string& out, std::string_view value);
 };
 #endif
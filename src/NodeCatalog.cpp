@@ -0,0 +1,336 @@
+#include "NodeCatalog.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char kMagic[8] = {'H', 'E', 'R', 'E', 'S', 'Y', 'N', 'C'};
+
+// 按空白把query分成几个词
+std::vector<std::string_view> splitTerms(std::string_view query) {
+    std::vector<std::string_view> terms;
+    size_t pos = 0;
+    while (pos < query.size()) {
+        size_t begin = query.find_first_not_of(" \t\r\n", pos);
+        if (begin == std::string_view::npos) {
+            break;
+        }
+        size_t end = query.find_first_of(" \t\r\n", begin);
+        if (end == std::string_view::npos) {
+            end = query.size();
+        }
+        terms.push_back(query.substr(begin, end - begin));
+        pos = end;
+    }
+    return terms;
+}
+
+char foldCase(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// ASCII不区分大小写的子串查找 和SQLite的LIKE一致
+bool containsIgnoreCase(std::string_view text, std::string_view term) {
+    if (term.size() > text.size()) {
+        return false;
+    }
+    for (size_t i = 0; i + term.size() <= text.size(); i++) {
+        size_t j = 0;
+        while (j < term.size() && foldCase(text[i + j]) == foldCase(term[j])) {
+            j++;
+        }
+        if (j == term.size()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifndef _WIN32
+// 纳秒精度的修改时间 删掉重写的文件可能拿到同一个inode 只看秒数分不出来
+int64_t modifiedTime(const struct stat& info) {
+    return static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+}
+#endif
+
+}  // namespace
+
+NodeCatalog::NodeCatalog(std::string path) : path(std::move(path)) {}
+
+NodeCatalog::~NodeCatalog() {
+    close();
+}
+
+bool NodeCatalog::refresh() {
+#ifdef _WIN32
+    // 还没有做Windows下的映射 一律查数据库
+    return false;
+#else
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        close();
+        return false;
+    }
+    if (data && static_cast<uint64_t>(info.st_ino) == inode &&
+        modifiedTime(info) == modified && static_cast<size_t>(info.st_size) == length) {
+        return true;
+    }
+    close();
+    return map();
+#endif
+}
+
+void NodeCatalog::close() {
+#ifndef _WIN32
+    if (data) {
+        munmap(const_cast<char*>(data), length);
+    }
+#endif
+    data = nullptr;
+    length = 0;
+    inode = 0;
+    modified = 0;
+}
+
+size_t NodeCatalog::size() const {
+    return data ? header()->recordCount : 0;
+}
+
+bool NodeCatalog::map() {
+#ifdef _WIN32
+    return false;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(CatalogHeader))) {
+        ::close(fd);
+        return false;
+    }
+
+    void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // 映射建立后文件描述符就不需要了
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    data = static_cast<const char*>(mapped);
+    length = static_cast<size_t>(info.st_size);
+    inode = static_cast<uint64_t>(info.st_ino);
+    modified = modifiedTime(info);
+    if (!validate()) {
+        close();
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool NodeCatalog::validate() const {
+    const CatalogHeader* head = header();
+    if (std::memcmp(head->magic, kMagic, sizeof(kMagic)) != 0 || head->version != kFormatVersion ||
+        head->recordSize != sizeof(CatalogRecord)) {
+        return false;
+    }
+    uint64_t expected = sizeof(CatalogHeader) + static_cast<uint64_t>(head->recordCount) * sizeof(CatalogRecord) +
+                        head->poolSize;
+    if (expected != length) {
+        return false;
+    }
+
+    // 只检查头部和总长度 打开时不逐条扫描记录 节点再多也是常数时间
+    // 记录里的偏移在text()里再检查 写坏的文件最多读出空字符串
+    return true;
+}
+
+const NodeCatalog::CatalogHeader* NodeCatalog::header() const {
+    return reinterpret_cast<const CatalogHeader*>(data);
+}
+
+const NodeCatalog::CatalogRecord* NodeCatalog::records() const {
+    return reinterpret_cast<const CatalogRecord*>(data + sizeof(CatalogHeader));
+}
+
+std::string_view NodeCatalog::text(const StringRef& ref) const {
+    const CatalogHeader* head = header();
+    if (static_cast<uint64_t>(ref.offset) + ref.length > head->poolSize) {
+        return std::string_view();
+    }
+    const char* pool = data + sizeof(CatalogHeader) + static_cast<size_t>(head->recordCount) * sizeof(CatalogRecord);
+    return std::string_view(pool + ref.offset, ref.length);
+}
+
+bool NodeCatalog::matches(const CatalogRecord& record, const NodeFilter& filter,
+                          const std::vector<std::string_view>& terms) const {
+    if (filter.subscribeId > 0 && record.subscribeId != filter.subscribeId) {
+        return false;
+    }
+    if (filter.canonicalOnly && record.canonicalId != 0) {
+        return false;
+    }
+    if (!filter.protocol.empty() && text(record.protocol) != filter.protocol) {
+        return false;
+    }
+    if (!filter.security.empty() && text(record.security) != filter.security) {
+        return false;
+    }
+    for (std::string_view term : terms) {
+        if (!containsIgnoreCase(text(record.info), term) && !containsIgnoreCase(text(record.addr), term)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool NodeCatalog::forEachNode(const NodeFilter& filter, const std::string& query,
+                              const std::function<bool(const NodeRow&)>& callback) const {
+    if (!data) {
+        return false;
+    }
+
+    // 先用id条件圈出一段连续的记录 [first, last)
+    const CatalogRecord* begin = records();
+    const CatalogRecord* end = begin + header()->recordCount;
+    auto lowerBound = [begin, end](int64_t id) {
+        return std::lower_bound(begin, end, id, [](const CatalogRecord& record, int64_t value) {
+            return record.id < value;
+        });
+    };
+    const CatalogRecord* first = begin;
+    const CatalogRecord* last = end;
+    if (filter.id > 0) {
+        first = lowerBound(filter.id);
+        last = lowerBound(static_cast<int64_t>(filter.id) + 1);
+    }
+    if (filter.afterId > 0) {
+        first = std::max(first, lowerBound(static_cast<int64_t>(filter.afterId) + 1));
+    }
+    if (filter.beforeId > 0) {
+        last = std::min(last, lowerBound(filter.beforeId));
+    }
+    if (first >= last) {
+        return true;
+    }
+
+    std::vector<std::string_view> terms = splitTerms(query);
+    int emitted = 0;
+    NodeRow row;
+    // 返回false时停止遍历
+    auto visit = [&](const CatalogRecord& record) {
+        if (!matches(record, filter, terms)) {
+            return true;
+        }
+        row.id = record.id;
+        row.subscribeId = record.subscribeId;
+        row.protocol = text(record.protocol);
+        row.addr = text(record.addr);
+        row.port = record.port;
+        row.info = text(record.info);
+        row.security = text(record.security);
+        row.canonicalId = record.canonicalId;
+        if (!callback(row)) {
+            return false;
+        }
+        emitted++;
+        return filter.limit <= 0 || emitted < filter.limit;
+    };
+
+    // 和数据库一样 设置了beforeId时从大到小
+    if (filter.beforeId > 0) {
+        for (const CatalogRecord* record = last; record != first;) {
+            if (!visit(*--record)) {
+                break;
+            }
+        }
+    } else {
+        for (const CatalogRecord* record = first; record != last; record++) {
+            if (!visit(*record)) {
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+void NodeCatalog::Writer::add(const NodeRow& row) {
+    CatalogRecord record;
+    record.id = row.id;
+    record.subscribeId = row.subscribeId;
+    record.canonicalId = row.canonicalId;
+    record.port = row.port;
+    record.protocol = appendShared(row.protocol);
+    record.addr = append(row.addr);
+    record.info = append(row.info);
+    record.security = appendShared(row.security);
+    records.push_back(record);
+}
+
+NodeCatalog::StringRef NodeCatalog::Writer::append(std::string_view value) {
+    StringRef ref{static_cast<uint32_t>(pool.size()), static_cast<uint32_t>(value.size())};
+    pool.append(value.data(), value.size());
+    return ref;
+}
+
+NodeCatalog::StringRef NodeCatalog::Writer::appendShared(std::string_view value) {
+    auto it = shared.find(std::string(value));
+    if (it != shared.end()) {
+        return it->second;
+    }
+    StringRef ref = append(value);
+    shared.emplace(std::string(value), ref);
+    return ref;
+}
+
+bool NodeCatalog::Writer::save(const std::string& path) const {
+    if (pool.size() > std::numeric_limits<uint32_t>::max() ||
+        records.size() > std::numeric_limits<uint32_t>::max()) {
+        return false;
+    }
+
+    CatalogHeader head;
+    std::memcpy(head.magic, kMagic, sizeof(kMagic));
+    head.version = kFormatVersion;
+    head.recordSize = sizeof(CatalogRecord);
+    head.recordCount = static_cast<uint32_t>(records.size());
+    head.poolSize = static_cast<uint32_t>(pool.size());
+
+    std::string temp = path + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&head), sizeof(head));
+        out.write(reinterpret_cast<const char*>(records.data()),
+                  static_cast<std::streamsize>(records.size() * sizeof(CatalogRecord)));
+        out.write(pool.data(), static_cast<std::streamsize>(pool.size()));
+        if (!out.flush()) {
+            out.close();
+            fs::remove(temp);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    fs::rename(temp, path, error);
+    if (error) {
+        fs::remove(temp, error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,113 @@
+#ifndef NODE_CATALOG_H
+#define NODE_CATALOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "DatabaseManager.h"
+
+// 节点目录 数据库里节点摘要(NodeProjection::Summary的列)的只读快照
+// 每次更新完订阅后写一份 启动时直接mmap进来 列表 搜索 按id查找都不用打开SQLite
+// 数据库里的节点一有变化这个文件就会被删掉(见DatabaseManager::invalidateCatalog)
+// 所以文件存在时它的内容就是最新的 不存在时调用方退回到数据库
+//
+// 文件格式(本机字节序 只给本机用):
+//   CatalogHeader
+//   CatalogRecord * recordCount  按id从小到大排列 定长 可以二分查找
+//   字符串池  记录里的字符串都是池里的偏移和长度
+class NodeCatalog {
+private:
+    struct StringRef {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct CatalogHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t recordSize;
+        uint32_t recordCount;
+        uint32_t poolSize;
+    };
+
+    struct CatalogRecord {
+        int32_t id;
+        int32_t subscribeId;
+        int32_t canonicalId;
+        int32_t port;
+        StringRef protocol;
+        StringRef addr;
+        StringRef info;
+        StringRef security;
+    };
+
+public:
+    // 格式变了就加一 旧文件会被当作不存在
+    static const uint32_t kFormatVersion = 1;
+
+    // 生成目录文件 按id从小到大add每个节点 最后save
+    class Writer {
+    public:
+        void add(const NodeRow& row);
+        // 先写临时文件再改名 读的一方不会看到写了一半的文件
+        bool save(const std::string& path) const;
+
+    private:
+        std::vector<CatalogRecord> records;
+        std::string pool;
+        // 协议和安全类型只有几种 池里每种只存一份
+        std::unordered_map<std::string, StringRef> shared;
+
+        StringRef append(std::string_view value);
+        StringRef appendShared(std::string_view value);
+    };
+
+    explicit NodeCatalog(std::string path);
+    ~NodeCatalog();
+
+    NodeCatalog(const NodeCatalog&) = delete;
+    NodeCatalog& operator=(const NodeCatalog&) = delete;
+
+    // 确认映射的是磁盘上现在的文件 文件换过了就重新映射
+    // 文件不存在或者格式不对时返回false 这时应该去查数据库
+    bool refresh();
+
+    // 解除映射
+    void close();
+
+    // 节点数(包括别名)
+    size_t size() const;
+
+    // 和DatabaseManager::forEachNode/searchNodes同样的过滤 排序和分页规则
+    // query非空时每个词都要出现在别名或地址里(ASCII不区分大小写)
+    // 回调拿到的字符串指向映射的内存 只在回调期间有效
+    bool forEachNode(const NodeFilter& filter, const std::string& query,
+                     const std::function<bool(const NodeRow&)>& callback) const;
+
+private:
+    std::string path;
+
+    // 当前映射的文件 用inode 修改时间(纳秒)和大小判断文件有没有换过
+    const char* data = nullptr;
+    size_t length = 0;
+    uint64_t inode = 0;
+    int64_t modified = 0;
+
+    const CatalogHeader* header() const;
+    const CatalogRecord* records() const;
+    std::string_view text(const StringRef& ref) const;
+
+    // 映射path 检查格式 失败时保持未映射的状态
+    bool map();
+    bool validate() const;
+
+    // 按filter检查一条记录 terms是已经分好的搜索词
+    bool matches(const CatalogRecord& record, const NodeFilter& filter,
+                 const std::vector<std::string_view>& terms) const;
+};
+
+#endif
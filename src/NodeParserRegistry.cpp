@@ -0,0 +1,159 @@
+#include "NodeParserRegistry.h"
+#include <cstring>
+#include "ProtocolTraits.h"
+
+namespace {
+
+// scheme里允许出现的字符(RFC 3986) 大写转成小写 不允许的为0
+constexpr std::array<char, 256> makeSchemeChars() {
+    std::array<char, 256> chars{};
+    for (int c = 'a'; c <= 'z'; c++) {
+        chars[c] = static_cast<char>(c);
+    }
+    for (int c = 'A'; c <= 'Z'; c++) {
+        chars[c] = static_cast<char>(c - 'A' + 'a');
+    }
+    for (int c = '0'; c <= '9'; c++) {
+        chars[c] = static_cast<char>(c);
+    }
+    chars['+'] = '+';
+    chars['-'] = '-';
+    chars['.'] = '.';
+    return chars;
+}
+
+constexpr std::array<char, 256> kSchemeChars = makeSchemeChars();
+
+// 取出行首"://"前面的scheme 转成小写写进buffer 返回长度 不是分享链接时返回0
+size_t extractScheme(std::string_view line, char* buffer) {
+    size_t len = 0;
+    while (len < line.size() && len <= NodeParserRegistry::kMaxSchemeLength) {
+        char c = kSchemeChars[static_cast<unsigned char>(line[len])];
+        if (!c) {
+            break;
+        }
+        buffer[len++] = c;
+    }
+    if (len == 0 || len > NodeParserRegistry::kMaxSchemeLength || line.substr(len, 3) != "://") {
+        return 0;
+    }
+    return len;
+}
+
+// 各协议的解析函数返回的是具体的节点类型 包一层
+template <typename T>
+std::optional<NodeRecord> parseAs(std::string_view line) {
+    std::optional<T> node = ProtocolTraits<T>::parse(line);
+    if (!node) {
+        return std::nullopt;
+    }
+    return NodeRecord(std::move(*node));
+}
+
+}  // namespace
+
+NodeParserRegistry::NodeParserRegistry() {
+    // 内置协议按NodeRecord::Variant里的顺序注册 scheme见各自的ProtocolTraits
+    forEachProtocol([this](auto tag) {
+        using T = typename decltype(tag)::type;
+        add(ProtocolTraits<T>::schemes.data(), ProtocolTraits<T>::schemes.size(), parseAs<T>);
+    });
+}
+
+NodeParserRegistry& NodeParserRegistry::instance() {
+    static NodeParserRegistry registry;
+    return registry;
+}
+
+bool NodeParserRegistry::add(std::initializer_list<std::string_view> schemes, Parser parser) {
+    return add(schemes.begin(), schemes.size(), parser);
+}
+
+bool NodeParserRegistry::add(const std::string_view* schemes, size_t count, Parser parser) {
+    if (count == 0 || !parser) {
+        return false;
+    }
+
+    // 先全部检查一遍 避免注册到一半失败
+    std::vector<std::string> normalized;
+    for (size_t i = 0; i < count; i++) {
+        std::string_view scheme = schemes[i];
+        std::string withSuffix = std::string(scheme) + "://";
+        char buffer[kMaxSchemeLength + 1];
+        size_t len = extractScheme(withSuffix, buffer);
+        if (len != scheme.size() || find(withSuffix) >= 0) {
+            return false;
+        }
+        normalized.emplace_back(buffer, len);
+    }
+
+    size_t index = protocols.size();
+    protocols.emplace_back();
+    protocols.back().name = normalized.front();
+    protocols.back().parser = parser;
+    for (auto& scheme : normalized) {
+        unsigned char first = static_cast<unsigned char>(scheme[0]);
+        table[first].push_back({std::move(scheme), index});
+    }
+    return true;
+}
+
+long NodeParserRegistry::find(std::string_view line) const {
+    char buffer[kMaxSchemeLength + 1];
+    size_t len = extractScheme(line, buffer);
+    if (len == 0) {
+        return -1;
+    }
+    for (const auto& scheme : table[static_cast<unsigned char>(buffer[0])]) {
+        if (scheme.text.size() == len && std::memcmp(scheme.text.data(), buffer, len) == 0) {
+            return static_cast<long>(scheme.protocol);
+        }
+    }
+    return -2;
+}
+
+std::optional<NodeRecord> NodeParserRegistry::parse(std::string_view line) {
+    long index = find(line);
+    if (index < 0) {
+        // 根本不是分享链接的行(空行 注释之类)不算
+        if (index == -2) {
+            unknown.fetch_add(1, std::memory_order_relaxed);
+        }
+        return std::nullopt;
+    }
+
+    Protocol& protocol = protocols[index];
+    std::optional<NodeRecord> node = protocol.parser(line);
+    if (node) {
+        protocol.hits.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        protocol.misses.fetch_add(1, std::memory_order_relaxed);
+    }
+    return node;
+}
+
+bool NodeParserRegistry::knows(std::string_view line) const {
+    return find(line) >= 0;
+}
+
+std::vector<NodeParserRegistry::Stats> NodeParserRegistry::stats() const {
+    std::vector<Stats> result;
+    result.reserve(protocols.size());
+    for (const auto& protocol : protocols) {
+        result.push_back({protocol.name, protocol.hits.load(std::memory_order_relaxed),
+                          protocol.misses.load(std::memory_order_relaxed)});
+    }
+    return result;
+}
+
+uint64_t NodeParserRegistry::unknownCount() const {
+    return unknown.load(std::memory_order_relaxed);
+}
+
+void NodeParserRegistry::resetStats() {
+    for (auto& protocol : protocols) {
+        protocol.hits.store(0, std::memory_order_relaxed);
+        protocol.misses.store(0, std::memory_order_relaxed);
+    }
+    unknown.store(0, std::memory_order_relaxed);
+}
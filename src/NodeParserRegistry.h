@@ -0,0 +1,92 @@
+#ifndef NODEPARSERREGISTRY_H
+#define NODEPARSERREGISTRY_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "NodeRecord.h"
+
+/*
+ * 分享链接解析器的注册表
+ * 按行首的scheme(vless:// hy2://这种)找到对应协议的解析函数 不用正则也不用一串if
+ * 一个协议可以有好几个scheme 比如hysteria2和hy2
+ * 内置协议的scheme和解析函数来自ProtocolTraits 别的协议(ss tuic socks...)也可以用add()注册
+ * 每个协议都记着解析成功和失败的次数 哪种链接解析不了一看就知道
+ */
+class NodeParserRegistry {
+   public:
+    // 解析函数 失败时返回空
+    // 会在多个解析线程里同时调用 不能有共享的可变状态 也不要往终端输出
+    using Parser = std::optional<NodeRecord> (*)(std::string_view line);
+
+    // 一个协议的解析统计
+    struct Stats {
+        std::string name;  // 协议名 也就是注册时的第一个scheme
+        uint64_t hits;     // 解析成功的行数
+        uint64_t misses;   // scheme认识但是解析失败的行数
+    };
+
+    // scheme最长多少个字符
+    static const size_t kMaxSchemeLength = 16;
+
+    // 全局唯一的注册表 内置的几种协议已经注册好了
+    static NodeParserRegistry& instance();
+
+    // 注册一个协议 schemes是它的所有scheme 第一个当作协议名
+    // scheme已经被占用或者格式不对时返回false 什么也不注册
+    // 注册要在开始解析之前做完 不能和parse()同时进行
+    bool add(std::initializer_list<std::string_view> schemes, Parser parser);
+    // 同上 scheme放在数组里 内置协议用ProtocolTraits里的scheme表注册
+    bool add(const std::string_view* schemes, size_t count, Parser parser);
+
+    // 把一行分享链接解析成节点 scheme没注册或解析失败时返回空
+    // 可以在多个线程里同时调用
+    std::optional<NodeRecord> parse(std::string_view line);
+
+    // 这一行的scheme有没有注册过
+    bool knows(std::string_view line) const;
+
+    // 每个协议的统计 按注册顺序
+    std::vector<Stats> stats() const;
+
+    // scheme没注册的分享链接行数 比如现在的ss://
+    uint64_t unknownCount() const;
+
+    // 统计清零
+    void resetStats();
+
+   private:
+    struct Protocol {
+        std::string name;
+        Parser parser;
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+    };
+
+    // scheme表里的一项 已经转成小写
+    struct Scheme {
+        std::string text;
+        size_t protocol;  // protocols里的下标
+    };
+
+    // 原子变量不能移动 用deque保证地址不变
+    std::deque<Protocol> protocols;
+
+    // 按scheme第一个字节分桶 每个桶里一般只有一两项
+    std::array<std::vector<Scheme>, 256> table;
+
+    std::atomic<uint64_t> unknown{0};
+
+    NodeParserRegistry();
+
+    // 找到这一行对应的协议下标 不是分享链接返回-1 scheme没注册返回-2
+    long find(std::string_view line) const;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef NODERECORD_H
+#define NODERECORD_H
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include "VlessNode.h"
+#include "VmessNode.h"
+#include "TrojanNode.h"
+#include "Hy2Node.h"
+
+/*
+ * 一个节点 按值保存具体协议的节点对象
+ * 以前解析出来的节点都是new出来的子类指针 到处是vector<Node*> 还要记得delete
+ * 现在放进std::vector<NodeRecord>就是连续的一块内存 出错提前返回也不会漏
+ * 要按协议做不同的事时用visit 不再先比较getProtocol()再static_cast
+ * 加新协议时在Variant里加一项 没处理它的visit会直接编译不过
+ */
+class NodeRecord {
+   public:
+    using Variant = std::variant<VlessNode, VmessNode, TrojanNode, Hy2Node>;
+
+    // 从任意一种协议的节点构造 隐式转换 parse函数可以直接返回子类对象
+    template <typename T, typename = std::enable_if_t<std::is_base_of_v<Node, std::decay_t<T>>>>
+    NodeRecord(T&& node) : value(std::forward<T>(node)) {}
+
+    // 公共字段(id 地址 别名...)
+    const Node& node() const {
+        return std::visit([](const Node& base) -> const Node& { return base; }, value);
+    }
+    Node& node() {
+        return std::visit([](Node& base) -> Node& { return base; }, value);
+    }
+
+    // 用具体的节点类型调用fn 一般传一个泛型lambda或者一组重载
+    template <typename Fn>
+    decltype(auto) visit(Fn&& fn) const {
+        return std::visit(std::forward<Fn>(fn), value);
+    }
+    template <typename Fn>
+    decltype(auto) visit(Fn&& fn) {
+        return std::visit(std::forward<Fn>(fn), value);
+    }
+
+    // 是T类型时返回指针 否则返回nullptr
+    template <typename T>
+    const T* get() const {
+        return std::get_if<T>(&value);
+    }
+
+   private:
+    Variant value;
+};
+
+#endif
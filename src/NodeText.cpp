@@ -0,0 +1,96 @@
+#include "NodeText.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+NodeText::NodeText(std::initializer_list<std::string_view> fields) {
+    assign(fields.begin(), fields.size());
+}
+
+NodeText::NodeText(const NodeText& other) {
+    if (other.block) {
+        size_t size = other.blockSize();
+        block.reset(new char[size]);
+        std::memcpy(block.get(), other.block.get(), size);
+    }
+}
+
+NodeText& NodeText::operator=(const NodeText& other) {
+    if (this != &other) {
+        *this = NodeText(other);
+    }
+    return *this;
+}
+
+void NodeText::assign(const std::string_view* fields, size_t count) {
+    // 末尾的空段不存
+    while (count > 0 && fields[count - 1].empty()) {
+        count--;
+    }
+    if (count == 0) {
+        block.reset();
+        return;
+    }
+
+    size_t size = sizeof(uint32_t) * (count + 1);
+    for (size_t i = 0; i < count; i++) {
+        size += fields[i].size();
+    }
+    // 先写进新的一块再换掉 fields可能指向旧的那块
+    std::unique_ptr<char[]> fresh(new char[size]);
+    uint32_t head = static_cast<uint32_t>(count);
+    std::memcpy(fresh.get(), &head, sizeof(head));
+    char* text = fresh.get() + sizeof(uint32_t) * (count + 1);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t length = static_cast<uint32_t>(fields[i].size());
+        std::memcpy(fresh.get() + sizeof(uint32_t) * (i + 1), &length, sizeof(length));
+        std::memcpy(text, fields[i].data(), length);
+        text += length;
+    }
+    block = std::move(fresh);
+}
+
+uint32_t NodeText::fieldCount() const {
+    uint32_t count = 0;
+    if (block) {
+        std::memcpy(&count, block.get(), sizeof(count));
+    }
+    return count;
+}
+
+uint32_t NodeText::length(size_t index) const {
+    uint32_t length = 0;
+    std::memcpy(&length, block.get() + sizeof(uint32_t) * (index + 1), sizeof(length));
+    return length;
+}
+
+size_t NodeText::blockSize() const {
+    uint32_t count = fieldCount();
+    size_t size = sizeof(uint32_t) * (count + 1);
+    for (size_t i = 0; i < count; i++) {
+        size += length(i);
+    }
+    return size;
+}
+
+std::string_view NodeText::get(size_t index) const {
+    uint32_t count = fieldCount();
+    if (index >= count) {
+        return std::string_view();
+    }
+    size_t offset = sizeof(uint32_t) * (count + 1);
+    for (size_t i = 0; i < index; i++) {
+        offset += length(i);
+    }
+    uint32_t size = length(index);
+    return size == 0 ? std::string_view() : std::string_view(block.get() + offset, size);
+}
+
+void NodeText::set(size_t index, std::string_view value) {
+    std::array<std::string_view, kMaxFields> fields{};
+    size_t count = std::max<size_t>(fieldCount(), index + 1);
+    for (size_t i = 0; i < count; i++) {
+        fields[i] = i == index ? value : get(i);
+    }
+    assign(fields.data(), count);
+}
@@ -0,0 +1,43 @@
+#ifndef NODETEXT_H
+#define NODETEXT_H
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string_view>
+
+/*
+ * 节点自己独有的几段文字: 地址 别名 密码 sni之类
+ * 每个节点都可能不一样 不能驻留(驻留池只增不减 订阅每刷新一次就多一批)
+ * 就合在一块刚好够大的内存里 对象本身只是一个指针 节点销毁时一起释放
+ * 内存里是 [段数][每段的长度...][各段文字] 全部为空时不分配
+ */
+class NodeText {
+   public:
+    // 最多几段
+    static const size_t kMaxFields = 6;
+
+    NodeText() = default;
+    NodeText(std::initializer_list<std::string_view> fields);
+    NodeText(const NodeText& other);
+    NodeText& operator=(const NodeText& other);
+    NodeText(NodeText&& other) noexcept = default;
+    NodeText& operator=(NodeText&& other) noexcept = default;
+
+    // 第index段 没有这一段时返回空
+    std::string_view get(size_t index) const;
+    // 把第index段换成value 其余几段不变
+    void set(size_t index, std::string_view value);
+
+   private:
+    std::unique_ptr<char[]> block;
+
+    uint32_t fieldCount() const;
+    uint32_t length(size_t index) const;
+    size_t blockSize() const;
+
+    // 按fields重新分配一块
+    void assign(const std::string_view* fields, size_t count);
+};
+
+#endif
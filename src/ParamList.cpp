@@ -0,0 +1,147 @@
+#include "ParamList.h"
+#include <cstring>
+#include <new>
+
+namespace {
+
+const uint32_t kInlineKey = 0x80000000u;   // 键不在词表里 文字放在值前面
+const uint32_t kKnownValue = 0x80000000u;  // 值在词表里 offset是编号
+
+}  // namespace
+
+ParamList::ParamList(const ParamList& other) : count(other.count), bytes(other.bytes) {
+    if (bytes > 0) {
+        block.reset(new char[bytes]);
+        std::memcpy(block.get(), other.block.get(), bytes);
+    }
+}
+
+ParamList::ParamList(ParamList&& other) noexcept
+    : block(std::move(other.block)), count(std::exchange(other.count, 0)), bytes(std::exchange(other.bytes, 0)) {}
+
+ParamList& ParamList::operator=(const ParamList& other) {
+    if (this != &other) {
+        *this = ParamList(other);
+    }
+    return *this;
+}
+
+ParamList& ParamList::operator=(ParamList&& other) noexcept {
+    block = std::move(other.block);
+    count = std::exchange(other.count, 0);
+    bytes = std::exchange(other.bytes, 0);
+    return *this;
+}
+
+std::string_view ParamList::pooled(uint32_t id) {
+    InternedString text;
+    text.id = id;
+    return text.view();
+}
+
+uint32_t ParamList::textBytes(const Slot& slot) {
+    if (slot.key & kInlineKey) {
+        return (slot.key & ~kInlineKey) + slot.length;
+    }
+    return (slot.length & kKnownValue) ? 0 : slot.length;
+}
+
+std::string_view ParamList::keyAt(uint32_t pos) const {
+    const Slot& slot = slots()[pos];
+    if (slot.key & kInlineKey) {
+        return std::string_view(text() + slot.offset, slot.key & ~kInlineKey);
+    }
+    return pooled(slot.key);
+}
+
+std::string_view ParamList::valueAt(uint32_t pos) const {
+    const Slot& slot = slots()[pos];
+    if (slot.key & kInlineKey) {
+        uint32_t keyLength = slot.key & ~kInlineKey;
+        return std::string_view(text() + slot.offset + keyLength, slot.length);
+    }
+    if (slot.length & kKnownValue) {
+        return pooled(slot.offset);
+    }
+    return std::string_view(text() + slot.offset, slot.length);
+}
+
+uint32_t ParamList::lowerBound(std::string_view key) const {
+    uint32_t low = 0;
+    uint32_t high = count;
+    while (low < high) {
+        uint32_t mid = low + (high - low) / 2;
+        if (keyAt(mid) < key) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+std::string_view ParamList::get(std::string_view key) const {
+    uint32_t pos = lowerBound(key);
+    if (pos < count && keyAt(pos) == key) {
+        return valueAt(pos);
+    }
+    return std::string_view();
+}
+
+void ParamList::set(std::string_view key, std::string_view value) {
+    uint32_t pos = lowerBound(key);
+    bool replace = pos < count && keyAt(pos) == key;
+
+    // 新的一项 键和值认识的话只存编号 链接里乱写的键不驻留
+    Slot fresh{};
+    if (replace) {
+        fresh.key = slots()[pos].key;
+    } else {
+        InternedString known = InternedString::known(key);
+        fresh.key = known.empty() ? (kInlineKey | static_cast<uint32_t>(key.size())) : known.id;
+    }
+    InternedString knownValue = (fresh.key & kInlineKey) ? InternedString() : InternedString::known(value);
+    fresh.length = knownValue.empty() ? static_cast<uint32_t>(value.size()) : kKnownValue;
+    fresh.offset = knownValue.id;
+
+    // 每次都重新分配一块刚好够大的 参数就几个 多复制几次也比留空位划算
+    uint32_t newCount = replace ? count : count + 1;
+    size_t newTextBytes = bytes - count * sizeof(Slot) - (replace ? textBytes(slots()[pos]) : 0) + textBytes(fresh);
+    size_t newBytes = newCount * sizeof(Slot) + newTextBytes;
+    std::unique_ptr<char[]> grown(new char[newBytes]);
+    char* newText = grown.get() + newCount * sizeof(Slot);
+
+    uint32_t offset = 0;
+    auto copy = [&](std::string_view part) {
+        if (!part.empty()) {
+            std::memcpy(newText + offset, part.data(), part.size());
+        }
+        offset += static_cast<uint32_t>(part.size());
+    };
+    for (uint32_t at = 0, from = 0; at < newCount; at++) {
+        Slot slot = fresh;
+        std::string_view slotKey = key;
+        std::string_view slotValue = value;
+        if (at != pos) {
+            slot = slots()[from];
+            slotKey = keyAt(from);
+            slotValue = valueAt(from);
+            from++;
+        } else if (replace) {
+            from++;
+        }
+        // 值在词表里时offset是编号 不能动
+        if ((slot.key & kInlineKey) || !(slot.length & kKnownValue)) {
+            slot.offset = offset;
+            if (slot.key & kInlineKey) {
+                copy(slotKey);
+            }
+            copy(slotValue);
+        }
+        new (grown.get() + at * sizeof(Slot)) Slot(slot);
+    }
+
+    block = std::move(grown);
+    count = newCount;
+    bytes = static_cast<uint32_t>(newBytes);
+}
@@ -0,0 +1,91 @@
+#ifndef PARAMLIST_H
+#define PARAMLIST_H
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <string_view>
+#include "InternedString.h"
+
+/*
+ * 节点的额外参数 键和值在驻留词表里(fp=chrome alpn=h2这种)就只存编号
+ * 其余的(path pbk sid 密码 链接里乱写的键...)是每个节点自己的 不能进只增不减的驻留池 和节点放在一起
+ * 按键排好序 和值的文字一起放在一块刚好够大的内存里 顺序和原来的std::map一样(指纹和内容哈希不受影响)
+ * 一个节点一般只有几个参数 查找就是在几项里二分 不用走红黑树 也没有每项一次的内存分配
+ */
+class ParamList {
+   private:
+    // 内存里的一项
+    // key: 驻留的编号 最高位是1时表示键不在词表里 文字放在文字区里值的前面 低位是键的长度
+    // offset length: 值在文字区里的位置和长度 length最高位是1时值在词表里 offset就是它的编号
+    struct Slot {
+        uint32_t key;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+   public:
+    // 遍历时给出的一项 值指向ParamList自己的内存 ParamList被修改或销毁之前有效
+    struct Entry {
+        std::string_view key;
+        std::string_view value;
+    };
+
+    class Iterator {
+       public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Entry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Entry;
+
+        Iterator(const ParamList* list, uint32_t pos) : list(list), pos(pos) {}
+        Entry operator*() const { return Entry{list->keyAt(pos), list->valueAt(pos)}; }
+        Iterator& operator++() {
+            ++pos;
+            return *this;
+        }
+        bool operator==(const Iterator& other) const { return pos == other.pos; }
+        bool operator!=(const Iterator& other) const { return pos != other.pos; }
+
+       private:
+        const ParamList* list;
+        uint32_t pos;
+    };
+
+    ParamList() = default;
+    ParamList(const ParamList& other);
+    ParamList& operator=(const ParamList& other);
+    ParamList(ParamList&& other) noexcept;
+    ParamList& operator=(ParamList&& other) noexcept;
+
+    // 没有这个键时返回空字符串
+    std::string_view get(std::string_view key) const;
+    // 已有的键覆盖值 没有就按顺序插进去
+    void set(std::string_view key, std::string_view value);
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    Iterator begin() const { return Iterator(this, 0); }
+    Iterator end() const { return Iterator(this, count); }
+
+   private:
+    // [Slot数组][所有值的文字]
+    std::unique_ptr<char[]> block;
+    uint32_t count = 0;
+    uint32_t bytes = 0;  // block的大小
+
+    const Slot* slots() const { return reinterpret_cast<const Slot*>(block.get()); }
+    const char* text() const { return block.get() + count * sizeof(Slot); }
+    std::string_view keyAt(uint32_t pos) const;
+    std::string_view valueAt(uint32_t pos) const;
+    // 这一项在文字区里占多少字节
+    static uint32_t textBytes(const Slot& slot);
+    static std::string_view pooled(uint32_t id);
+
+    // 第一个键不小于key的位置
+    uint32_t lowerBound(std::string_view key) const;
+};
+
+#endif
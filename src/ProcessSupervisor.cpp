@@ -0,0 +1,265 @@
+#include "ProcessSupervisor.h"
+
+#ifndef _WIN32
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include "process_util.h"
+
+namespace {
+
+// 这么长时间里自动重启的次数受Options::maxRestarts限制
+const std::chrono::seconds kRestartWindow(60);
+// 第n次自动重启前等n倍的这么长时间
+const std::chrono::milliseconds kRestartDelay(500);
+// SIGTERM之后最多等多久 还不退出就SIGKILL
+const std::chrono::seconds kStopTimeout(3);
+// 等端口和等进程退出时的轮询间隔 从短到长
+const std::chrono::milliseconds kPollFirst(10);
+const std::chrono::milliseconds kPollMax(200);
+
+// /proc/pid/comm里的程序名和name一样吗 没有/proc的系统上不检查
+bool processNameIs(int pid, const std::string& name) {
+    std::ifstream comm("/proc/" + std::to_string(pid) + "/comm");
+    if (!comm) {
+        return true;
+    }
+    std::string actual;
+    std::getline(comm, actual);
+    // comm最多15个字符
+    return actual == name.substr(0, 15);
+}
+
+// pid还在吗 给别的用户的进程发信号会失败 这种也当作不在
+bool processAlive(int pid) {
+    return pid > 0 && kill(pid, 0) == 0;
+}
+
+}  // namespace
+
+ProcessSupervisor::ProcessSupervisor(const std::string& name, const std::string& pidFile)
+    : state(std::make_shared<State>()) {
+    state->name = name;
+    state->pidFile = pidFile;
+    adopt();
+}
+
+ProcessSupervisor::~ProcessSupervisor() {
+    // 子进程留着继续运行 后台线程还要帮它回收和重启 所以只是放手不等它
+    if (monitor.joinable()) {
+        monitor.detach();
+    }
+}
+
+void ProcessSupervisor::adopt() {
+    if (state->pidFile.empty()) {
+        return;
+    }
+    // 第一行是pid和启动的程序文件名 程序路径可以配置 所以不能拿固定的名字对照
+    std::ifstream file(state->pidFile);
+    int pid = 0;
+    std::string program;
+    if (!(file >> pid)) {
+        return;
+    }
+    if (!(file >> program)) {
+        program = state->name;
+    }
+    if (!processAlive(pid) || !processNameIs(pid, program)) {
+        return;
+    }
+    state->pid = pid;
+    state->adopted = true;
+}
+
+void ProcessSupervisor::writePidFile(const State& state, int pid) {
+    if (!state.pidFile.empty()) {
+        // 按/proc/pid/comm的规矩只留文件名 比如/opt/xray/xray-linux-64记成xray-linux-64
+        std::string program = state.options.args.front();
+        size_t slash = program.rfind('/');
+        if (slash != std::string::npos) {
+            program = program.substr(slash + 1);
+        }
+        std::ofstream(state.pidFile) << pid << ' ' << program << '\n';
+    }
+}
+
+void ProcessSupervisor::removePidFile(const State& state) {
+    if (!state.pidFile.empty()) {
+        std::remove(state.pidFile.c_str());
+    }
+}
+
+bool ProcessSupervisor::isRunning() const {
+    if (state->adopted) {
+        // 认回来的进程不是自己的子进程 收不到它退出的消息 只能问一下
+        return processAlive(state->pid);
+    }
+    // 崩溃后等着自动重启的那一会儿pid是0 也算在运行 后台线程放弃或者被停掉才算停了
+    return state->monitoring;
+}
+
+int ProcessSupervisor::pid() const {
+    // 等着自动重启时是0
+    return isRunning() ? state->pid.load() : 0;
+}
+
+bool ProcessSupervisor::start(const Options& options) {
+    if (isRunning()) {
+        return true;
+    }
+    // 走到这里后台线程一定已经结束了(被停掉 或者重启太多次放弃了) join不会卡住
+    if (monitor.joinable()) {
+        monitor.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->options = options;
+        state->stopping = false;
+        state->restarts.clear();
+        state->adopted = false;
+    }
+
+    int pid = spawnProgram(options.args);
+    if (pid < 0) {
+        std::cerr << "无法启动" << state->name << ": " << options.args.front() << std::endl;
+        return false;
+    }
+    state->pid = pid;
+    state->monitoring = true;
+    writePidFile(*state, pid);
+    monitor = std::thread(monitorLoop, state, pid);
+
+    if (options.readyPort > 0 && !waitReady()) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+bool ProcessSupervisor::waitReady() {
+    const Options& options = state->options;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(options.readyTimeoutMs);
+    auto interval = kPollFirst;
+    while (true) {
+        if (localPortOpen(options.readyPort)) {
+            return true;
+        }
+        // 一启动就退出 自动重启也放弃了
+        if (!state->monitoring) {
+            std::cerr << state->name << "启动后马上退出了 检查一下配置文件" << std::endl;
+            return false;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            std::cerr << state->name << "启动后" << options.readyTimeoutMs << "毫秒内没有监听端口"
+                      << options.readyPort << std::endl;
+            return false;
+        }
+        std::this_thread::sleep_for(interval);
+        interval = std::min(interval * 2, kPollMax);
+    }
+}
+
+void ProcessSupervisor::monitorLoop(std::shared_ptr<State> state, int pid) {
+    while (true) {
+        int status = 0;
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->pid = 0;
+        if (state->stopping) {
+            break;
+        }
+
+        // 不是自己停的 算崩溃
+        auto now = std::chrono::steady_clock::now();
+        while (!state->restarts.empty() && now - state->restarts.front() > kRestartWindow) {
+            state->restarts.pop_front();
+        }
+        if (static_cast<int>(state->restarts.size()) >= state->options.maxRestarts) {
+            std::cerr << state->name << "一分钟内退出了" << state->restarts.size() + 1 << "次 不再自动重启"
+                      << std::endl;
+            break;
+        }
+        state->restarts.push_back(now);
+
+        // 等一会儿再拉起来 等的时候被要求停止就不重启了
+        auto delay = kRestartDelay * static_cast<int>(state->restarts.size());
+        if (state->changed.wait_for(lock, delay, [&state]() { return state->stopping; })) {
+            break;
+        }
+        pid = spawnProgram(state->options.args);
+        if (pid < 0) {
+            std::cerr << "无法重新启动" << state->name << std::endl;
+            break;
+        }
+        state->pid = pid;
+        writePidFile(*state, pid);
+        std::cerr << state->name << "意外退出 已经自动重启" << std::endl;
+    }
+
+    // 在锁里改 stop()检查完条件还没开始等的时候不会漏掉通知
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        removePidFile(*state);
+        state->monitoring = false;
+    }
+    state->changed.notify_all();
+}
+
+bool ProcessSupervisor::stop() {
+    if (state->adopted) {
+        return stopAdopted();
+    }
+    if (!monitor.joinable()) {
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->stopping = true;
+    int pid = state->pid;
+    if (pid > 0) {
+        kill(pid, SIGTERM);
+    }
+    state->changed.notify_all();
+    if (!state->changed.wait_for(lock, kStopTimeout, [this]() { return !state->monitoring; })) {
+        std::cerr << state->name << "没有响应SIGTERM 强制结束" << std::endl;
+        if (state->pid > 0) {
+            kill(state->pid, SIGKILL);
+        }
+        state->changed.wait(lock, [this]() { return !state->monitoring; });
+    }
+    lock.unlock();
+
+    monitor.join();
+    return true;
+}
+
+bool ProcessSupervisor::stopAdopted() {
+    int pid = state->pid;
+    if (processAlive(pid)) {
+        kill(pid, SIGTERM);
+        auto deadline = std::chrono::steady_clock::now() + kStopTimeout;
+        auto interval = kPollFirst;
+        while (processAlive(pid) && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(interval);
+            interval = std::min(interval * 2, kPollMax);
+        }
+        if (processAlive(pid)) {
+            std::cerr << state->name << "没有响应SIGTERM 强制结束" << std::endl;
+            kill(pid, SIGKILL);
+        }
+    }
+    state->pid = 0;
+    state->adopted = false;
+    removePidFile(*state);
+    return true;
+}
+
+#endif
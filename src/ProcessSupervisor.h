@@ -0,0 +1,88 @@
+#ifndef PROCESSSUPERVISOR_H
+#define PROCESSSUPERVISOR_H
+
+#ifndef _WIN32
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * 看管一个后台子进程(xray或者hysteria)
+ * 用posix_spawn启动 只认自己启动的那个pid 停止时只给它发信号 不会误杀别的用户或者别的程序的同名进程
+ * 后台线程一直阻塞在waitpid上 子进程一退出马上回收 不留僵尸
+ * 不是自己停掉的(崩溃了)就等一会儿自动重启 一分钟内退出太多次就不再管它
+ * 启动后反复连它监听的端口 连上了才算启动好 不再固定睡一两秒
+ * 是否在运行存在原子变量里 查询不用fork也不用读进程表
+ * pid和程序文件名写进pid文件 heresy退出后子进程照常运行 下次启动时按pid文件认回来
+ * Windows上还是用ConfigManager里原来的办法
+ */
+class ProcessSupervisor {
+   public:
+    struct Options {
+        std::vector<std::string> args;  // 程序和参数 args[0]在PATH里找
+        int readyPort = 0;              // 启动后等本机这个端口能连上才算启动好 0表示不等
+        int readyTimeoutMs = 5000;      // 最多等多久
+        int maxRestarts = 3;            // 一分钟内最多自动重启几次
+    };
+
+    // name用在提示信息里 pid文件里没记程序文件名时也拿它对照 pidFile为空时不写pid文件
+    ProcessSupervisor(const std::string& name, const std::string& pidFile);
+    // 不停止子进程 它会继续运行 下次靠pid文件认回来
+    ~ProcessSupervisor();
+
+    ProcessSupervisor(const ProcessSupervisor&) = delete;
+    ProcessSupervisor& operator=(const ProcessSupervisor&) = delete;
+
+    // 启动并等它准备好 已经在运行时直接返回true
+    // 启动不了 或者超时还没开始监听端口时返回false 这时子进程已经被停掉
+    bool start(const Options& options);
+
+    // 先SIGTERM 等一会儿还不退出就SIGKILL 没在运行时直接返回true
+    bool stop();
+
+    // 崩溃后等着自动重启的时候也返回true
+    bool isRunning() const;
+
+    // 没在运行 或者正等着自动重启时返回0
+    int pid() const;
+
+   private:
+    // 和后台线程共用的状态 线程结束前一直由它持有
+    struct State {
+        std::string name;
+        std::string pidFile;
+        Options options;
+
+        std::mutex mutex;
+        std::condition_variable changed;  // 子进程退出 或者要停止时通知
+        bool stopping = false;
+        std::deque<std::chrono::steady_clock::time_point> restarts;  // 最近一分钟内自动重启的时间
+
+        std::atomic<int> pid{0};
+        std::atomic<bool> adopted{false};    // 从pid文件认回来的 不是自己的子进程 不能waitpid
+        std::atomic<bool> monitoring{false}; // 后台线程还在看管
+    };
+
+    std::shared_ptr<State> state;
+    std::thread monitor;
+
+    static void monitorLoop(std::shared_ptr<State> state, int pid);
+    static void writePidFile(const State& state, int pid);
+    static void removePidFile(const State& state);
+
+    // 按pid文件认回上次留下的进程
+    void adopt();
+    bool waitReady();
+    bool stopAdopted();
+};
+
+#endif
+
+#endif
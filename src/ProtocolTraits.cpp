@@ -0,0 +1,242 @@
+#include "ProtocolTraits.h"
+#include "DatabaseManager.h"
+
+using json = nlohmann::json;
+
+namespace {
+
+// 额外参数里有专门列的键 其他键都放进extra_params
+const std::pair<const char*, std::string_view NodeColumns::*> kExtraParamColumns[] = {
+    {"sni", &NodeColumns::sni},
+    {"host", &NodeColumns::host},
+    {"path", &NodeColumns::path},
+    {"serviceName", &NodeColumns::serviceName},
+    {"flow", &NodeColumns::flow},
+    {"fp", &NodeColumns::tlsFingerprint},
+    {"pbk", &NodeColumns::publicKey},
+    {"sid", &NodeColumns::shortId},
+    {"alpn", &NodeColumns::alpn},
+};
+
+// 把节点的额外参数分到专门的列和extra_params里
+// 值为空的参数也放进extra_params 这样读回来时和原来完全一样
+void splitExtraParams(const ParamList& params, NodeColumns& columns) {
+    json rest = json::object();
+    for (const auto& param : params) {
+        bool typed = false;
+        if (!param.value.empty()) {
+            for (const auto& column : kExtraParamColumns) {
+                if (param.key == column.first) {
+                    columns.*column.second = param.value;
+                    typed = true;
+                    break;
+                }
+            }
+        }
+        if (!typed) {
+            rest[std::string(param.key)] = std::string(param.value);
+        }
+    }
+    // 值是按百分号解码出来的 不一定是合法的UTF-8 不合法的字节换成U+FFFD 不然dump会抛出异常
+    columns.extraParams = rest.empty() ? "" : rest.dump(-1, ' ', false, json::error_handler_t::replace);
+}
+
+// 把专门的列和extra_params还原成节点的额外参数
+// skipSni为true时sni列不算额外参数(trojan和hy2的sni是单独的成员)
+template <typename T>
+void restoreExtraParams(const NodeRow& row, bool skipSni, T& node) {
+    const std::string_view values[] = {
+        row.sni, row.host, row.path, row.serviceName, row.flow,
+        row.tlsFingerprint, row.publicKey, row.shortId, row.alpn,
+    };
+    static_assert(sizeof(values) / sizeof(values[0]) == sizeof(kExtraParamColumns) / sizeof(kExtraParamColumns[0]),
+                  "restoreExtraParams和kExtraParamColumns的列要一一对应");
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        if (skipSni && i == 0) {
+            continue;
+        }
+        if (!values[i].empty()) {
+            node.setExtraParam(kExtraParamColumns[i].first, values[i]);
+        }
+    }
+
+    if (row.extraParams.empty()) {
+        return;
+    }
+    json rest = json::parse(row.extraParams.begin(), row.extraParams.end(), nullptr, false);
+    if (!rest.is_object()) {
+        return;
+    }
+    for (const auto& item : rest.items()) {
+        if (item.value().is_string()) {
+            node.setExtraParam(item.key(), item.value().get_ref<const std::string&>());
+        }
+    }
+}
+
+// 按protocol列还原节点用的表 由Variant里的类型生成 顺序相同
+using RowDecoder = NodeRecord (*)(const NodeRow& row);
+
+struct RowProtocol {
+    std::string_view name;
+    RowDecoder decode;
+};
+
+template <typename T>
+NodeRecord decodeAs(const NodeRow& row) {
+    return NodeRecord(ProtocolTraits<T>::decode(row));
+}
+
+template <typename... Ts>
+constexpr std::array<RowProtocol, sizeof...(Ts)> makeRowProtocols(const std::variant<Ts...>*) {
+    return {{{ProtocolTraits<Ts>::name, decodeAs<Ts>}...}};
+}
+
+constexpr auto kRowProtocols = makeRowProtocols(static_cast<const NodeRecord::Variant*>(nullptr));
+
+}  // namespace
+
+// vless
+
+std::optional<VlessNode> ProtocolTraits<VlessNode>::parse(std::string_view line) {
+    return VlessNode::parseFromUrl(line);
+}
+
+void ProtocolTraits<VlessNode>::bind(const VlessNode& node, NodeColumns& columns) {
+    columns.type = node.getType();
+    columns.encryption = node.getEncryption();
+    columns.security = node.getSecurity();
+    splitExtraParams(node.getExtraParams(), columns);
+}
+
+VlessNode ProtocolTraits<VlessNode>::decode(const NodeRow& row) {
+    VlessNode node(
+        row.uuid, row.addr, row.port, row.info,
+        row.type.empty() ? "tcp" : row.type,
+        row.encryption.empty() ? "none" : row.encryption,
+        row.security.empty() ? "none" : row.security
+    );
+    restoreExtraParams(row, false, node);
+    return node;
+}
+
+void ProtocolTraits<VlessNode>::outbound(const VlessNode& node, json& out) {
+    node.toXrayConfig(out);
+}
+
+// vmess
+
+std::optional<VmessNode> ProtocolTraits<VmessNode>::parse(std::string_view line) {
+    // VmessNode::parseFromUrl失败时会打印原因 这里用不打印的版本
+    std::optional<VmessNode> node;
+    if (VmessNode::tryParse(line, node) != VmessNode::ParseStatus::Ok) {
+        return std::nullopt;
+    }
+    return node;
+}
+
+void ProtocolTraits<VmessNode>::bind(const VmessNode& node, NodeColumns& columns) {
+    columns.type = node.getType();
+    columns.encryption = node.getSecurity();
+    columns.security = node.getTls();
+    columns.alterId = node.getAlterId();
+    splitExtraParams(node.getExtraParams(), columns);
+}
+
+VmessNode ProtocolTraits<VmessNode>::decode(const NodeRow& row) {
+    VmessNode node(
+        row.uuid, row.addr, row.port, row.info,
+        row.alterId,
+        row.encryption.empty() ? "auto" : row.encryption,
+        row.type.empty() ? "tcp" : row.type,
+        row.security
+    );
+    restoreExtraParams(row, false, node);
+    return node;
+}
+
+void ProtocolTraits<VmessNode>::outbound(const VmessNode& node, json& out) {
+    node.toXrayConfig(out);
+}
+
+// trojan
+
+std::optional<TrojanNode> ProtocolTraits<TrojanNode>::parse(std::string_view line) {
+    return TrojanNode::parseFromUrl(line);
+}
+
+void ProtocolTraits<TrojanNode>::bind(const TrojanNode& node, NodeColumns& columns) {
+    splitExtraParams(node.getExtraParams(), columns);
+    columns.type = node.getType();
+    columns.sni = node.getSni();
+}
+
+TrojanNode ProtocolTraits<TrojanNode>::decode(const NodeRow& row) {
+    TrojanNode node(
+        row.uuid, row.addr, row.port, row.info,
+        row.sni.empty() ? row.addr : row.sni,
+        row.type.empty() ? "tcp" : row.type
+    );
+    restoreExtraParams(row, true, node);
+    return node;
+}
+
+void ProtocolTraits<TrojanNode>::outbound(const TrojanNode& node, json& out) {
+    node.toXrayConfig(out);
+}
+
+// hysteria2
+
+std::optional<Hy2Node> ProtocolTraits<Hy2Node>::parse(std::string_view line) {
+    return Hy2Node::parseFromUrl(line);
+}
+
+void ProtocolTraits<Hy2Node>::bind(const Hy2Node& node, NodeColumns& columns) {
+    splitExtraParams(node.getExtraParams(), columns);
+    columns.sni = node.getSni();
+    columns.obfs = node.getObfs();
+    columns.obfsPassword = node.getObfsPassword();
+    columns.insecure = node.getInsecure();
+}
+
+Hy2Node ProtocolTraits<Hy2Node>::decode(const NodeRow& row) {
+    Hy2Node node(
+        row.uuid, row.addr, row.port, row.info,
+        row.sni.empty() ? row.addr : row.sni,
+        row.obfs,
+        row.obfsPassword,
+        row.insecure
+    );
+    restoreExtraParams(row, true, node);
+    return node;
+}
+
+void ProtocolTraits<Hy2Node>::outbound(const Hy2Node& node, json& out) {
+    node.toXrayConfig(out);
+}
+
+NodeColumns columnsFromNode(const NodeRecord& record) {
+    NodeColumns columns;
+    record.visit([&columns](const auto& node) {
+        ProtocolTraits<std::decay_t<decltype(node)>>::bind(node, columns);
+    });
+    return columns;
+}
+
+std::optional<NodeRecord> nodeFromRow(const NodeRow& row) {
+    for (const RowProtocol& protocol : kRowProtocols) {
+        if (protocol.name == row.protocol) {
+            NodeRecord record = protocol.decode(row);
+            record.node().setId(row.id);
+            return record;
+        }
+    }
+    // 只有以后版本写进数据库的协议才会走到这里
+    return std::nullopt;
+}
+
+void outboundFromNode(const NodeRecord& record, json& out) {
+    record.visit([&out](const auto& node) {
+        ProtocolTraits<std::decay_t<decltype(node)>>::outbound(node, out);
+    });
+}
@@ -0,0 +1,148 @@
+#ifndef PROTOCOLTRAITS_H
+#define PROTOCOLTRAITS_H
+
+#include <array>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <nlohmann/json.hpp>
+#include "NodeRecord.h"
+
+// 数据库里的一行 定义在DatabaseManager.h 这里只用到引用
+struct NodeRow;
+
+// 节点表里各协议参数对应的列
+// type是传输方式 encryption和security在各协议下的含义:
+//   vless: encryption / security(none tls reality)
+//   vmess: scy加密方式 / tls
+// 常用的参数各有一列 其余的额外参数以JSON对象存在extra_params里
+// 文本列都是指向节点自己(驻留池或NodeText)的视图 只有extra_params是新拼出来的
+struct NodeColumns {
+    std::string_view type;
+    std::string_view encryption;
+    std::string_view security;
+    std::string_view sni;
+    std::string_view host;
+    std::string_view path;
+    std::string_view serviceName;
+    std::string_view flow;
+    std::string_view tlsFingerprint;
+    std::string_view publicKey;
+    std::string_view shortId;
+    std::string_view alpn;
+    std::string_view obfs;
+    std::string_view obfsPassword;
+    int alterId = 0;
+    bool insecure = false;
+    std::string extraParams;
+};
+
+/*
+ * 每种协议在一个地方说清楚自己的全部差异 一个协议一个特化:
+ *   name     nodes表protocol列里的值 也是节点的getProtocol()
+ *   schemes  分享链接的scheme 第一个是解析统计里显示的名字
+ *   parse    分享链接 -> 节点 失败返回空 会在多个线程里同时调用 不要往终端输出
+ *   bind     节点 -> 数据库的列
+ *   decode   数据库的一行(Full模式) -> 节点 不设置id
+ *   outbound 节点 -> Xray的出站配置 直接写进调用方配置树里的一项
+ * 用的地方都是对NodeRecord做visit 编译时就确定调哪个特化 不再比较协议字符串
+ * 加新协议: 写好节点类 放进NodeRecord::Variant 再在这里加一个特化
+ * 少了特化或者少了哪一项 下面的static_assert会编译不过
+ */
+template <typename T>
+struct ProtocolTraits;
+
+template <>
+struct ProtocolTraits<VlessNode> {
+    static constexpr std::string_view name = "vless";
+    static constexpr std::array<std::string_view, 1> schemes = {"vless"};
+    static std::optional<VlessNode> parse(std::string_view line);
+    static void bind(const VlessNode& node, NodeColumns& columns);
+    static VlessNode decode(const NodeRow& row);
+    static void outbound(const VlessNode& node, nlohmann::json& out);
+};
+
+template <>
+struct ProtocolTraits<VmessNode> {
+    static constexpr std::string_view name = "vmess";
+    static constexpr std::array<std::string_view, 1> schemes = {"vmess"};
+    static std::optional<VmessNode> parse(std::string_view line);
+    static void bind(const VmessNode& node, NodeColumns& columns);
+    static VmessNode decode(const NodeRow& row);
+    static void outbound(const VmessNode& node, nlohmann::json& out);
+};
+
+template <>
+struct ProtocolTraits<TrojanNode> {
+    static constexpr std::string_view name = "trojan";
+    static constexpr std::array<std::string_view, 1> schemes = {"trojan"};
+    static std::optional<TrojanNode> parse(std::string_view line);
+    static void bind(const TrojanNode& node, NodeColumns& columns);
+    static TrojanNode decode(const NodeRow& row);
+    static void outbound(const TrojanNode& node, nlohmann::json& out);
+};
+
+template <>
+struct ProtocolTraits<Hy2Node> {
+    static constexpr std::string_view name = "hy2";
+    static constexpr std::array<std::string_view, 2> schemes = {"hysteria2", "hy2"};
+    static std::optional<Hy2Node> parse(std::string_view line);
+    static void bind(const Hy2Node& node, NodeColumns& columns);
+    static Hy2Node decode(const NodeRow& row);
+    static void outbound(const Hy2Node& node, nlohmann::json& out);
+};
+
+// 类型标签 forEachProtocol用它把节点类型传给泛型lambda
+template <typename T>
+struct ProtocolTag {
+    using type = T;
+};
+
+// T有没有一个完整的ProtocolTraits特化 每一项的签名都要对
+template <typename T, typename = void>
+struct HasProtocolTraits : std::false_type {};
+
+template <typename T>
+struct HasProtocolTraits<T, std::void_t<
+    decltype(ProtocolTraits<T>::name),
+    decltype(ProtocolTraits<T>::schemes),
+    decltype(ProtocolTraits<T>::parse(std::declval<std::string_view>())),
+    decltype(ProtocolTraits<T>::bind(std::declval<const T&>(), std::declval<NodeColumns&>())),
+    decltype(ProtocolTraits<T>::decode(std::declval<const NodeRow&>())),
+    decltype(ProtocolTraits<T>::outbound(std::declval<const T&>(), std::declval<nlohmann::json&>()))>>
+    : std::bool_constant<
+          std::is_convertible_v<decltype(ProtocolTraits<T>::name), std::string_view> &&
+          std::is_same_v<decltype(ProtocolTraits<T>::parse(std::declval<std::string_view>())), std::optional<T>> &&
+          std::is_same_v<decltype(ProtocolTraits<T>::decode(std::declval<const NodeRow&>())), T>> {};
+
+template <typename... Ts>
+constexpr bool allHaveProtocolTraits(const std::variant<Ts...>*) {
+    return (HasProtocolTraits<Ts>::value && ...);
+}
+
+static_assert(allHaveProtocolTraits(static_cast<const NodeRecord::Variant*>(nullptr)),
+              "NodeRecord::Variant里的每种节点都要有完整的ProtocolTraits特化");
+
+template <typename... Ts, typename Fn>
+void forEachProtocol(const std::variant<Ts...>*, Fn& fn) {
+    (fn(ProtocolTag<Ts>{}), ...);
+}
+
+// 按Variant里的顺序对每种协议调用fn(ProtocolTag<节点类型>{})
+template <typename Fn>
+void forEachProtocol(Fn&& fn) {
+    forEachProtocol(static_cast<const NodeRecord::Variant*>(nullptr), fn);
+}
+
+// 节点 -> 数据库的列
+NodeColumns columnsFromNode(const NodeRecord& record);
+
+// 数据库的一行 -> 节点 按protocol列找到对应的特化 不认识的协议返回空
+std::optional<NodeRecord> nodeFromRow(const NodeRow& row);
+
+// 节点 -> Xray的出站配置 写进out 一般是outbounds数组里新加的一项
+void outboundFromNode(const NodeRecord& record, nlohmann::json& out);
+
+#endif
@@ -18,6 +18,18 @@ std::string Subscribe::getUrl(void) const {
     return url;
 }
 
+std::string Subscribe::getEtag(void) const {
+    return etag;
+}
+
+std::string Subscribe::getLastModified(void) const {
+    return lastModified;
+}
+
+std::string Subscribe::getContentHash(void) const {
+    return contentHash;
+}
+
 // Setter 方法
 void Subscribe::setId(int id) {
     this->id = id;
@@ -28,6 +40,23 @@ void Subscribe::setName(std::string name) {
 }
 
 void Subscribe::setUrl(std::string url) {
+    if (this->url != url) {
+        etag.clear();
+        lastModified.clear();
+        contentHash.clear();
+    }
     this->url = url;
 }
 
+void Subscribe::setEtag(std::string etag) {
+    this->etag = etag;
+}
+
+void Subscribe::setLastModified(std::string lastModified) {
+    this->lastModified = lastModified;
+}
+
+void Subscribe::setContentHash(std::string contentHash) {
+    this->contentHash = contentHash;
+}
+
@@ -16,6 +16,13 @@ class Subscribe {
     // 订阅链接
     std::string url;
 
+    // 上次下载时服务器返回的ETag和Last-Modified 用于条件请求
+    std::string etag;
+    std::string lastModified;
+
+    // 上次导入的订阅内容的哈希 内容没变就不用重新解析
+    std::string contentHash;
+
    public:
     //构造函数
     Subscribe(int id, const std::string& name, const std::string& url);
@@ -24,8 +31,15 @@ class Subscribe {
     int getId(void) const;
     std::string getName(void) const;
     std::string getUrl(void) const;
+    std::string getEtag(void) const;
+    std::string getLastModified(void) const;
+    std::string getContentHash(void) const;
     void setId(int id);
     void setName(std::string name);
+    // 换了链接之后 之前的缓存信息就作废了 会一并清空
     void setUrl(std::string url);
+    void setEtag(std::string etag);
+    void setLastModified(std::string lastModified);
+    void setContentHash(std::string contentHash);
 };
 #endif
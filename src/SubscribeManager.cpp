@@ -1,20 +1,22 @@
 #include "SubscribeManager.h"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
-#include <sstream>
+#include <memory>
 #include <string>
-#include <regex>
+#include <thread>
+#include <vector>
+#include "BoundedQueue.h"
 #include "Node.h"
 #include "Subscribe.h"
+#include "SubscribeStream.h"
 #include "http_util.h"
-#include "base64.h"
-#include "VlessNode.h"
-#include "VmessNode.h"
-#include "TrojanNode.h"
-#include "Hy2Node.h"
 #include "DatabaseManager.h"
+#include "NodeParserRegistry.h"
+#include "ThreadPool.h"
 
 //更新订阅的函数
-void SubscribeManager::update(Subscribe subscribe) {
+void SubscribeManager::update(Subscribe subscribe, int parseWorkers) {
     //提取出它的订阅链接
     std::string url = subscribe.getUrl();
 
@@ -24,76 +26,230 @@ void SubscribeManager::update(Subscribe subscribe) {
         return;
     }
 
-    //用包装好的下载工具下载这个url 得到base64编码后的节点信息
-    std::string base64_sub = downloadFromURL(url);
-    if(base64_sub.empty()) {
-        std::cout << "下载订阅内容失败，请检查网络连接或订阅链接" << std::endl;
+    //用包装好的下载工具下载这个url 下载到的base64内容直接流进解析管线
+    //带上上次的ETag/Last-Modified 内容没变的话服务器直接回304
+    NodeParserRegistry::instance().resetStats();
+    std::unique_ptr<ThreadPool> pool = makeParsePool(parseWorkers);
+    SubscribeStream stream(pool.get());
+    DownloadRequest request;
+    request.url = url;
+    request.etag = subscribe.getEtag();
+    request.lastModified = subscribe.getLastModified();
+    request.onData = [&stream](const char* data, size_t len) { return stream.feed(data, len); };
+    DownloadResult result = downloadFromURL(request);
+
+    // 打开数据库连接
+    DatabaseManager dbManager;
+    if (!dbManager.open()) {
+        std::cout << "无法打开数据库，更新订阅失败" << std::endl;
         return;
     }
 
-    //用base64解码得到多行字符串
-    std::string decode_sub = base64_decode(base64_sub);
-    if(decode_sub.empty()) {
-        std::cout << "解码订阅内容失败，可能不是有效的base64编码" << std::endl;
-        return;
+    //和updateAll一样 出错只算这个分组更新失败 不让异常一路跑出CLI
+    try {
+        handleDownload(subscribe, result, stream, dbManager);
+    } catch (const std::exception& e) {
+        std::cout << "[" << subscribe.getName() << "] 更新失败：" << e.what() << std::endl;
     }
+    //节点有变化的话目录已经被删掉了 重新生成一份给下次启动用
+    dbManager.refreshCatalog();
+    printParseStats();
+}
 
-    // 打开数据库连接
+//并发更新所有订阅分组
+void SubscribeManager::updateAll(int maxConcurrency, int parseWorkers) {
     DatabaseManager dbManager;
     if (!dbManager.open()) {
         std::cout << "无法打开数据库，更新订阅失败" << std::endl;
         return;
     }
 
-    // 先删除该订阅下的所有节点
-    dbManager.deleteAllNodesInSubscribe(subscribe.getId());
+    //没有链接的分组跳过
+    std::vector<Subscribe> subscribes;
+    for (const auto& subscribe : dbManager.getAllSubscribes()) {
+        if (subscribe.getUrl().empty()) {
+            std::cout << "[" << subscribe.getName() << "] 此订阅分组无法更新：无链接" << std::endl;
+            continue;
+        }
+        subscribes.push_back(subscribe);
+    }
 
-    //对刚刚的字符串进行逐行的解析
-    std::istringstream stream(decode_sub);
-    std::string line;
-    //用来截取协议字段的正则表达式
-    std::regex protocolReg(R"(^([a-zA-Z0-9]+)://)");
-    std::smatch match;
-
-    int success_count = 0;
-    int failed_count = 0;
-
-    //跑个循环把每行东西拎出来 根据它的协议 扔给对应协议的处理器
-    while (std::getline(stream, line)) {
-        if(std::regex_search(line, match, protocolReg)) {
-            //取得协议
-            std::string protocol = match[1].str();
-
-            //调用处理器把这一行的节点内容转换成对应协议的节点对象
-            Node* node = nullptr;
-
-            if (protocol == "vless") {
-                node = VlessNode::parseFromUrl(line);
-            } else if (protocol == "vmess") {
-                node = VmessNode::parseFromUrl(line);
-            } else if (protocol == "trojan") {
-                node = TrojanNode::parseFromUrl(line);
-            } else if (protocol == "hy2" || protocol == "hysteria2") {
-                node = Hy2Node::parseFromUrl(line);
+    if (subscribes.empty()) {
+        std::cout << "没有可以更新的订阅" << std::endl;
+        return;
+    }
+
+    //每个分组一条自己的解析管线 解析工作都交给同一个线程池
+    std::unique_ptr<ThreadPool> pool = makeParsePool(parseWorkers);
+    std::vector<std::unique_ptr<SubscribeStream>> streams;
+    std::vector<DownloadRequest> requests;
+    for (const auto& subscribe : subscribes) {
+        streams.push_back(std::make_unique<SubscribeStream>(pool.get()));
+        SubscribeStream* stream = streams.back().get();
+
+        DownloadRequest request;
+        request.url = subscribe.getUrl();
+        request.etag = subscribe.getEtag();
+        request.lastModified = subscribe.getLastModified();
+        request.onData = [stream](const char* data, size_t len) { return stream->feed(data, len); };
+        requests.push_back(request);
+    }
+
+    NodeParserRegistry::instance().resetStats();
+    std::cout << "开始更新 " << requests.size() << " 个订阅，并发数：" << maxConcurrency << std::endl;
+
+    //数据库连接只由写库线程使用 下载线程把下载完的分组按完成顺序排进队列
+    //写库线程按同样的顺序逐个等解析结束 写库 输出结果
+    struct Finished {
+        size_t index;
+        DownloadResult result;
+        std::unique_ptr<SubscribeStream> stream;
+    };
+    //onDone在curl_multi的线程里调用 push等待的话其他分组的下载也跟着停住
+    //容量等于分组数 每个分组只放一次 push永远不用等 排队的只是几个句柄 节点本来就在stream里
+    BoundedQueue<Finished> finished(requests.size());
+    std::thread writer([&]() {
+        Finished item;
+        while (finished.pop(item)) {
+            //一个分组出错(比如内存不够)只算这个分组失败 异常不能跑出线程 否则整个程序直接结束
+            try {
+                handleDownload(subscribes[item.index], item.result, *item.stream, dbManager);
+            } catch (const std::exception& e) {
+                std::cout << "[" << subscribes[item.index].getName() << "] 更新失败：" << e.what() << std::endl;
+            } catch (...) {
+                std::cout << "[" << subscribes[item.index].getName() << "] 更新失败：未知错误" << std::endl;
             }
+            //这个分组的节点已经写进数据库了 释放掉
+            item.stream.reset();
+        }
+    });
 
-            if (node) {
-                // 添加到数据库
-                if (dbManager.addNode(node, subscribe.getId())) {
-                    success_count++;
-                } else {
-                    failed_count++;
-                }
-                
-                // 释放内存
-                delete node;
-            } else {
-                std::cout << "无法解析节点: " << line.substr(0, 50) << "..." << std::endl;
-                failed_count++;
+    //离开这一块时关掉队列 等写库线程写完剩下的分组
+    //下载中途抛出异常时也一样 还能join的线程被销毁会直接结束程序
+    {
+        struct WriterGuard {
+            BoundedQueue<Finished>& queue;
+            std::thread& thread;
+            ~WriterGuard() {
+                queue.close();
+                thread.join();
             }
+        } writerGuard{finished, writer};
+
+        downloadAll(requests, maxConcurrency, [&](size_t index, DownloadResult& result) {
+            finished.push({index, std::move(result), std::move(streams[index])});
+        });
+    }
+    dbManager.refreshCatalog();
+    printParseStats();
+}
+
+//parseWorkers为1时不开线程 在下载线程里直接解析
+//没有指定时可以用环境变量HERESY_PARSE_WORKERS设置
+std::unique_ptr<ThreadPool> SubscribeManager::makeParsePool(int parseWorkers) {
+    if (parseWorkers == kAutoParseWorkers) {
+        const char* env = std::getenv("HERESY_PARSE_WORKERS");
+        if (env) {
+            parseWorkers = std::max(0, std::atoi(env));
         }
     }
+    if (parseWorkers == 1) {
+        return nullptr;
+    }
+    return std::make_unique<ThreadPool>(parseWorkers > 0 ? static_cast<size_t>(parseWorkers) : 0);
+}
+
+//按协议输出这次更新的解析情况 没有解析过任何节点(比如全部304)时不输出
+void SubscribeManager::printParseStats() {
+    const NodeParserRegistry& registry = NodeParserRegistry::instance();
+    std::string line;
+    for (const auto& stats : registry.stats()) {
+        if (stats.hits == 0 && stats.misses == 0) {
+            continue;
+        }
+        line += (line.empty() ? "" : "，") + stats.name + " 成功" + std::to_string(stats.hits) +
+                " 失败" + std::to_string(stats.misses);
+    }
+    if (registry.unknownCount() > 0) {
+        line += (line.empty() ? "" : "，") + std::string("不支持的协议 ") + std::to_string(registry.unknownCount());
+    }
+    if (!line.empty()) {
+        std::cout << "解析统计：" << line << std::endl;
+    }
+}
+
+//处理一个分组的下载结果
+//304或者内容哈希和上次一样时 跳过写库
+void SubscribeManager::handleDownload(Subscribe subscribe, const DownloadResult& result,
+                                      SubscribeStream& stream, DatabaseManager& dbManager) {
+    const std::string prefix = "[" + subscribe.getName() + "] ";
+
+    if (stream.decodeFailed()) {
+        std::cout << prefix << "解码订阅内容失败，可能不是有效的base64编码" << std::endl;
+        return;
+    }
+
+    //解析出错时下载已经被中止了 节点不完整 不能入库
+    if (stream.parseFailed()) {
+        std::cout << prefix << "解析订阅内容出错：" << stream.parseError() << std::endl;
+        return;
+    }
+
+    if (!result.ok) {
+        std::cout << prefix << "下载订阅内容失败：" << result.error << std::endl;
+        return;
+    }
+
+    if (result.notModified) {
+        std::cout << prefix << "订阅内容未变化，跳过更新" << std::endl;
+        //304里不一定带验证器 带了才覆盖
+        if (!result.etag.empty() || !result.lastModified.empty()) {
+            subscribe.setEtag(result.etag);
+            subscribe.setLastModified(result.lastModified);
+            dbManager.updateSubscribeCache(subscribe);
+        }
+        return;
+    }
+
+    if (stream.bytesReceived() == 0) {
+        std::cout << prefix << "下载订阅内容失败：内容为空" << std::endl;
+        return;
+    }
+
+    std::string contentHash = stream.contentHash();
+    subscribe.setEtag(result.etag);
+    subscribe.setLastModified(result.lastModified);
+
+    //服务器不支持条件请求时 靠内容哈希判断有没有变化
+    if (contentHash == subscribe.getContentHash()) {
+        std::cout << prefix << "订阅内容未变化，跳过更新" << std::endl;
+        dbManager.updateSubscribeCache(subscribe);
+        return;
+    }
+
+    if (!stream.finish()) {
+        if (stream.parseFailed()) {
+            std::cout << prefix << "解析订阅内容出错：" << stream.parseError() << std::endl;
+        } else {
+            std::cout << prefix << "解码订阅内容失败，可能不是有效的base64编码" << std::endl;
+        }
+        return;
+    }
+
+    //只插入新增的 更新变化的 删除消失的 没变的节点id保持不变
+    NodeSyncStats stats;
+    if (!dbManager.syncSubscribeNodes(subscribe.getId(), stream.nodes(), stats)) {
+        std::cout << prefix << "写入数据库失败，订阅内容保持不变" << std::endl;
+        return;
+    }
+
+    subscribe.setContentHash(contentHash);
+    dbManager.updateSubscribeCache(subscribe);
 
-    std::cout << "订阅更新完成，成功导入节点：" << success_count 
-              << "，失败节点：" << failed_count << std::endl;
+    std::cout << prefix << "订阅更新完成，新增：" << stats.added
+              << "，修改：" << stats.changed
+              << "，删除：" << stats.removed
+              << "，未变：" << stats.unchanged
+              << "，重复：" << stats.duplicates
+              << "，解析失败：" << stream.failedCount() << std::endl;
 }
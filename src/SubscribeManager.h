@@ -11,11 +11,41 @@
 #ifndef SUBSCRIBEMANAGER_H
 #define SUBSCRIBEMANAGER_H
 
+#include <memory>
 #include "Subscribe.h"
 
+class DatabaseManager;
+class SubscribeStream;
+class ThreadPool;
+struct DownloadResult;
+
 class SubscribeManager{
     public:
-        static void update(Subscribe subscribe);
+        // updateAll默认同时进行的下载数
+        static const int kDefaultConcurrency = 8;
+
+        // 解析线程数 0表示和CPU核数一样(可以用环境变量HERESY_PARSE_WORKERS改) 1表示不开线程 在下载线程里直接解析
+        static const int kAutoParseWorkers = 0;
+
+        static void update(Subscribe subscribe, int parseWorkers = kAutoParseWorkers);
+
+        // 并发更新全部订阅分组
+        // 最多同时下载maxConcurrency个分组 哪个先下载完就先导入哪个并输出结果
+        // 总耗时接近最慢的那个机场 而不是所有机场耗时之和
+        // 节点在parseWorkers个线程里并行解析 写库只在一个线程里进行
+        static void updateAll(int maxConcurrency = kDefaultConcurrency, int parseWorkers = kAutoParseWorkers);
+
+    private:
+        // 按parseWorkers创建解析线程池 不需要线程池时返回空
+        static std::unique_ptr<ThreadPool> makeParsePool(int parseWorkers);
+
+        // 处理一个分组的下载结果 内容没变时直接跳过 变了就把解析出的节点同步进数据库
+        // 成功后记下新的ETag/Last-Modified和内容哈希
+        static void handleDownload(Subscribe subscribe, const DownloadResult& result,
+                                   SubscribeStream& stream, DatabaseManager& dbManager);
+
+        // 输出每种协议解析成功/失败的行数(NodeParserRegistry的统计)
+        static void printParseStats();
 };
 
 #endif
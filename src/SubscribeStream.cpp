@@ -0,0 +1,185 @@
+#include "SubscribeStream.h"
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include "hash_util.h"
+#include "NodeParserRegistry.h"
+#include "ThreadPool.h"
+
+SubscribeStream::SubscribeStream(ThreadPool* pool)
+    : hash(fnv1a64("")), bytes(0), pool(pool), maxPending(pool ? pool->size() * 2 : 0), dropped(0) {}
+
+bool SubscribeStream::feed(const char* data, size_t len) {
+    if (!error.empty()) {
+        return false;
+    }
+    hash = fnv1a64(std::string_view(data, len), hash);
+    bytes += len;
+
+    // 异常不能穿过curl的C回调 在这里接住 返回false让curl中止下载
+    try {
+        decoded.clear();
+        if (!decoder.feed(data, len, decoded)) {
+            return false;
+        }
+        splitter.feed(decoded, [this](std::string_view line) { handleLine(line); });
+    } catch (const std::exception& e) {
+        error = e.what();
+    } catch (...) {
+        error = "未知错误";
+    }
+    return error.empty();
+}
+
+bool SubscribeStream::finish() {
+    if (!error.empty()) {
+        return false;
+    }
+    try {
+        decoded.clear();
+        if (!decoder.finish(decoded)) {
+            return false;
+        }
+        auto onLine = [this](std::string_view line) { handleLine(line); };
+        splitter.feed(decoded, onLine);
+        splitter.finish(onLine);
+        dropped = static_cast<int>(splitter.droppedLines());
+
+        submitChunk();
+        while (!pending.empty() && error.empty()) {
+            collectFront();
+        }
+    } catch (const std::exception& e) {
+        error = e.what();
+    } catch (...) {
+        error = "未知错误";
+    }
+    if (!error.empty()) {
+        return false;
+    }
+
+    for (const auto& failure : failures) {
+        std::cout << "无法解析节点: " << failure << "..." << std::endl;
+    }
+    return true;
+}
+
+bool SubscribeStream::decodeFailed() const {
+    return decoder.failed();
+}
+
+bool SubscribeStream::parseFailed() const {
+    return !error.empty();
+}
+
+const std::string& SubscribeStream::parseError() const {
+    return error;
+}
+
+size_t SubscribeStream::bytesReceived() const {
+    return bytes;
+}
+
+std::string SubscribeStream::contentHash() const {
+    return hashToHex(hash);
+}
+
+std::vector<NodeRecord>& SubscribeStream::nodes() {
+    return parsed;
+}
+
+int SubscribeStream::failedCount() const {
+    return static_cast<int>(failures.size()) + dropped;
+}
+
+void SubscribeStream::handleLine(std::string_view line) {
+    if (line.empty()) {
+        return;
+    }
+
+    if (!pool) {
+        ChunkResult result;
+        parseInto(line, result);
+        merge(std::move(result));
+        return;
+    }
+
+    chunk.append(line.data(), line.size());
+    chunk.push_back('\n');
+    if (chunk.size() >= kChunkBytes) {
+        submitChunk();
+    }
+}
+
+void SubscribeStream::submitChunk() {
+    if (chunk.empty()) {
+        return;
+    }
+
+    // 解析太慢时先等最早的一块 不让待解析的数据无限堆积
+    while (pending.size() >= maxPending) {
+        collectFront();
+    }
+
+    pending.push_back(pool->submit([lines = std::move(chunk)]() {
+        // 异常在工作线程里接住 记在结果里 收回来时再作废整个订阅
+        ChunkResult result;
+        try {
+            std::string_view rest(lines);
+            while (!rest.empty()) {
+                size_t end = rest.find('\n');
+                parseInto(rest.substr(0, end), result);
+                rest = end == std::string_view::npos ? std::string_view() : rest.substr(end + 1);
+            }
+        } catch (const std::exception& e) {
+            result = ChunkResult();
+            result.error = e.what();
+        } catch (...) {
+            result = ChunkResult();
+            result.error = "未知错误";
+        }
+        return result;
+    }));
+    chunk = std::string();
+    chunk.reserve(kChunkBytes + LineSplitter::kDefaultMaxLineLength);
+}
+
+void SubscribeStream::collectFront() {
+    ChunkResult result = pending.front().get();
+    pending.pop_front();
+    merge(std::move(result));
+}
+
+void SubscribeStream::parseInto(std::string_view line, ChunkResult& result) {
+    if (line.empty()) {
+        return;
+    }
+
+    std::optional<NodeRecord> node = parseLine(line);
+    if (node) {
+        result.nodes.push_back(std::move(*node));
+    } else if (line.find("://") != std::string_view::npos) {
+        result.failures.emplace_back(line.substr(0, 50));
+    }
+}
+
+void SubscribeStream::merge(ChunkResult&& result) {
+    if (!result.error.empty()) {
+        error = std::move(result.error);
+        return;
+    }
+    if (parsed.empty()) {
+        parsed = std::move(result.nodes);
+    } else {
+        parsed.insert(parsed.end(), std::make_move_iterator(result.nodes.begin()),
+                      std::make_move_iterator(result.nodes.end()));
+    }
+    for (auto& failure : result.failures) {
+        failures.push_back(std::move(failure));
+    }
+}
+
+std::optional<NodeRecord> SubscribeStream::parseLine(std::string_view line) {
+    //按协议交给注册好的解析函数 把这一行的节点内容转换成对应协议的节点对象
+    return NodeParserRegistry::instance().parse(line);
+}
@@ -0,0 +1,115 @@
+#ifndef SUBSCRIBESTREAM_H
+#define SUBSCRIBESTREAM_H
+
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "NodeRecord.h"
+#include "stream_util.h"
+
+class ThreadPool;
+
+/*
+ * 订阅内容的流式处理管线 一个订阅分组一个
+ * 下载到的数据块 -> base64增量解码 -> 按行切分 -> 按协议解析成节点
+ * 直接挂在curl的写回调上 解析和下载同时进行
+ * 原始内容和解码后的内容都不会被完整保存 内存占用只和数据块大小有关 和订阅大小无关
+ * 最后留下来的只有解析出来的节点 按值连续地放在一个数组里
+ *
+ * 给了线程池时 切好的行攒成一块(按行对齐)交给线程池解析 下载线程只负责解码和切行
+ * 同时在解析的块数有上限 解析跟不上时下载线程会等一等
+ * 结果按块的顺序收回来 节点顺序和失败信息的顺序都和一行一行解析时一样
+ */
+class SubscribeStream {
+   private:
+    // 一块交给线程池的行的解析结果
+    struct ChunkResult {
+        std::vector<NodeRecord> nodes;
+        std::vector<std::string> failures;  // 解析失败的行(截断过的)
+        std::string error;                  // 解析时抛出了异常 整块作废
+    };
+
+    // 每块攒到这么多字节就交出去
+    static const size_t kChunkBytes = 256 * 1024;
+
+    Base64StreamDecoder decoder;
+    LineSplitter splitter;
+
+    // 解码缓冲区 每个数据块复用同一块内存
+    std::string decoded;
+
+    // 原始内容的哈希和长度 边收边算
+    uint64_t hash;
+    size_t bytes;
+
+    ThreadPool* pool;
+    std::string chunk;  // 正在攒的一块 行之间用\n隔开
+    std::deque<std::future<ChunkResult>> pending;  // 已经交给线程池 还没收回的块
+    size_t maxPending;
+
+    std::vector<NodeRecord> parsed;
+    std::vector<std::string> failures;
+    int dropped;  // 超长被丢掉的行
+    std::string error;  // 解析时出的异常 不为空时整个订阅作废
+
+    // 处理一行 有线程池时先攒起来 否则直接解析
+    void handleLine(std::string_view line);
+
+    // 把攒好的一块交给线程池
+    void submitChunk();
+
+    // 等最早交出去的那块解析完 把结果收进来
+    void collectFront();
+
+    // 解析一行 结果放进result
+    static void parseInto(std::string_view line, ChunkResult& result);
+
+    // 把收回来的结果并进parsed和failures
+    void merge(ChunkResult&& result);
+
+   public:
+    // pool为空时在调用feed的线程里直接解析
+    explicit SubscribeStream(ThreadPool* pool = nullptr);
+
+    // 喂入一块下载到的原始数据 base64不合法或者解析出错时返回false
+    // 在curl的写回调里调用 不会抛出异常
+    bool feed(const char* data, size_t len);
+
+    // 下载结束 处理缓冲区里剩下的内容 等所有块解析完
+    // 然后按原来的行顺序输出解析失败的行
+    // base64不合法或者解析出错时返回false 不会抛出异常
+    bool finish();
+
+    // base64内容不合法
+    bool decodeFailed() const;
+
+    // 解析时抛出了异常(比如内存不够) 这时已经解析的节点不完整 不能入库
+    bool parseFailed() const;
+
+    // 解析出错的原因
+    const std::string& parseError() const;
+
+    // 收到的原始字节数
+    size_t bytesReceived() const;
+
+    // 原始内容的哈希 和hashHex(整个响应)相同
+    std::string contentHash() const;
+
+    // 解析成功的节点 要在finish之后调用
+    // 入库时会填上数据库id 所以给的是可修改的引用
+    std::vector<NodeRecord>& nodes();
+
+    // 解析失败的行数 要在finish之后调用
+    int failedCount() const;
+
+    // 把一行分享链接解析成节点 不认识的协议或解析失败时返回空
+    // 见NodeParserRegistry
+    static std::optional<NodeRecord> parseLine(std::string_view line);
+};
+
+#endif
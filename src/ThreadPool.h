@@ -0,0 +1,57 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/*
+ * 固定线程数的线程池 用来并行解析订阅里的节点
+ * 任务按提交顺序开始执行 结果通过std::future取回 调用方按自己需要的顺序get就能保证输出顺序
+ * 析构时会先把队列里剩下的任务做完再退出
+ */
+class ThreadPool {
+   public:
+    // threads为0时使用CPU核数
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // 提交一个任务 返回它的结果
+    template <typename Fn>
+    std::future<std::invoke_result_t<Fn>> submit(Fn&& fn) {
+        using Result = std::invoke_result_t<Fn>;
+        // packaged_task不能复制 std::function要求可复制 所以包一层shared_ptr
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+        std::future<Result> future = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return future;
+    }
+
+    // 线程数
+    size_t size() const;
+
+    // threads参数为0时实际会用的线程数
+    static size_t defaultSize();
+
+   private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable ready;
+    bool stopping = false;
+
+    void enqueue(std::function<void()> task);
+    void run();
+};
+
+#endif
@@ -1,126 +1,102 @@
 #include "TrojanNode.h"
-#include <iostream>
-#include <regex>
-#include <sstream>
+#include "ProtocolTraits.h"
 #include <nlohmann/json.hpp>
 #include "base64.h"
+#include "share_link.h"
 
 using json = nlohmann::json;
 
-TrojanNode::TrojanNode(std::string password, std::string addr, int port, std::string info,
-                     std::string sni, std::string type)
-    : Node("trojan", password, addr, port, info), 
-      sni(sni),
-      type(type) {
+TrojanNode::TrojanNode(std::string_view password, std::string_view addr, int port, std::string_view info,
+                     std::string_view sni, std::string_view type)
+    : Node(ProtocolTraits<TrojanNode>::name, password, addr, port, info) {
+    setType(type);
+    setSni(sni);
 }
 
-TrojanNode* TrojanNode::parseFromUrl(const std::string& url) {
+std::optional<TrojanNode> TrojanNode::parseFromUrl(std::string_view url) {
     // trojan://password@host:port?sni=example.com&type=tcp#info
-    std::regex trojanRegex(R"(trojan://([^@]+)@([^:]+):(\d+)\??([^#]*)(?:#(.*))?)", std::regex::ECMAScript);
-    std::smatch match;
-
-    if (!std::regex_match(url, match, trojanRegex)) {
-        std::cerr << "无法解析节点: " << url.substr(0, 50) << "..." << std::endl;
-        return nullptr;
+    ShareLink link;
+    if (!parseShareLink(url, link) || !schemeIs(link, "trojan")) {
+        return std::nullopt;
     }
 
-    std::string password = match[1].str();
-    std::string addr = match[2].str();
-    int port = std::stoi(match[3].str());
-    std::string params = match[4].str();
-    std::string info = match[5].str();
-
-    // URL解码info (处理中文和特殊字符)
-    info = urlDecode(info);
-
     // 默认使用host作为SNI
-    std::string sni = addr;
-    std::string type = "tcp";
-
-    // 解析参数
-    if (!params.empty()) {
-        std::stringstream ss(params);
-        std::string param;
-
-        while (std::getline(ss, param, '&')) {
-            size_t pos = param.find('=');
-            if (pos != std::string::npos) {
-                std::string key = param.substr(0, pos);
-                std::string value = param.substr(pos + 1);
-                
-                // URL解码参数值
-                value = urlDecode(value);
-
-                if (key == "sni") {
-                    sni = value;
-                } else if (key == "type") {
-                    type = value;
+    std::string_view addr = link.host;
+    TrojanNode node(link.userinfo, addr, link.port,
+                    percentDecode(link.fragment), addr);
+
+    // 有的客户端用peer表示sni 只在没有sni参数时采用
+    bool hasSni = false;
+    forEachQueryParam(link.query, [&node, &hasSni](QueryKey key, std::string_view name, std::string_view raw) {
+        std::string value = percentDecode(raw);
+        switch (key) {
+            case QueryKey::Sni:
+                node.setSni(value);
+                hasSni = true;
+                break;
+            case QueryKey::Peer:
+                if (!hasSni) {
+                    node.setSni(value);
                 }
-            }
+                break;
+            case QueryKey::Type: node.setType(value); break;
+            default:
+                // path host serviceName等传输层参数 生成配置时会用到
+                node.setExtraParam(name, value);
+                break;
         }
-    }
+    });
 
-    // 创建节点
-    TrojanNode* node = new TrojanNode(password, addr, port, info, sni, type);
     return node;
 }
 
-// URL解码函数
-std::string TrojanNode::urlDecode(const std::string& encoded) {
-    std::string result;
-    char ch;
-    int i, len = encoded.length();
-    
-    for (i = 0; i < len; i++) {
-        if (encoded[i] == '%') {
-            if (i + 2 < len) {
-                std::string hex = encoded.substr(i + 1, 2);
-                int value = 0;
-                std::istringstream(hex) >> std::hex >> value;
-                ch = static_cast<char>(value);
-                result += ch;
-                i += 2;
-            }
-        } else if (encoded[i] == '+') {
-            result += ' ';
-        } else {
-            result += encoded[i];
-        }
-    }
-    
-    return result;
+std::string_view TrojanNode::getSni() const {
+    std::string_view value = getOwnText(kSni);
+    return value.empty() ? getAddr() : value;
 }
 
-std::string TrojanNode::getSni() const {
-    return sni;
+std::string_view TrojanNode::getType() const {
+    return getToken(type, kTypeToken);
 }
 
-std::string TrojanNode::getType() const {
-    return type;
+std::string_view TrojanNode::getExtraParam(std::string_view key) const {
+    return extra_params.get(key);
 }
 
-std::string TrojanNode::getExtraParam(const std::string& key) const {
-    auto it = extra_params.find(key);
-    if (it != extra_params.end()) {
-        return it->second;
-    }
-    return "";
+const ParamList& TrojanNode::getExtraParams() const {
+    return extra_params;
+}
+
+void TrojanNode::setSni(std::string_view sni) {
+    // 大多数节点的SNI就是自己的地址 这时不存
+    setOwnText(kSni, sni == getAddr() ? std::string_view() : sni);
 }
 
-void TrojanNode::setSni(const std::string& sni) {
-    this->sni = sni;
+void TrojanNode::setType(std::string_view type) {
+    setToken(this->type, kTypeToken, type);
 }
 
-void TrojanNode::setType(const std::string& type) {
-    this->type = type;
+void TrojanNode::setExtraParam(std::string_view key, std::string_view value) {
+    extra_params.set(key, value);
 }
 
-void TrojanNode::setExtraParam(const std::string& key, const std::string& value) {
-    extra_params[key] = value;
+void TrojanNode::appendIdentity(std::string& out) const {
+    appendField(out, getToken(type, kTypeToken));
+    appendField(out, getExtraParam("path"));
+    appendField(out, getExtraParam("host"));
+    appendField(out, getExtraParam("serviceName"));
 }
 
-std::string TrojanNode::toXrayConfig() const {
-    json outbound = {
+void TrojanNode::appendDetails(std::string& out) const {
+    appendField(out, getSni());
+    for (const auto& param : extra_params) {
+        appendField(out, param.key);
+        appendField(out, param.value);
+    }
+}
+
+void TrojanNode::toXrayConfig(json& outbound) const {
+    outbound = {
         {"protocol", "trojan"},
         {"settings", {
             {"servers", json::array({
@@ -168,6 +144,4 @@ std::string TrojanNode::toXrayConfig() const {
         
         streamSettings["grpcSettings"] = grpcSettings;
     }
-    
-    return outbound.dump(4);
 } 
\ No newline at end of file
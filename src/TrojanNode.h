@@ -2,7 +2,10 @@
 #define TROJANNODE_H
 #include "Node.h"
 #include <string>
-#include <map>
+#include <string_view>
+#include "ParamList.h"
+#include <optional>
+#include <nlohmann/json_fwd.hpp>
 
 /* trojan协议的节点的实体类
  * 父类Node已有以下几个属性...
@@ -16,32 +19,39 @@
 class TrojanNode : public Node {
    private:
     // 额外参数
-    std::string sni;  // SNI
-    std::string type;  // 传输方式，默认为tcp
-    std::map<std::string, std::string> extra_params;
-
-    // URL解码工具函数
-    static std::string urlDecode(const std::string& encoded);
+    InternedString type;  // 传输方式，默认为tcp
+    // 存在Node的文字里的段号: 不认识的type 和地址不一样的SNI
+    enum OwnText { kTypeToken, kSni };
+    ParamList extra_params;
 
    public:
     // 构造函数
-    TrojanNode(std::string password, std::string addr, int port, std::string info,
-              std::string sni = "", std::string type = "tcp");
+    TrojanNode(std::string_view password, std::string_view addr, int port, std::string_view info,
+              std::string_view sni = "", std::string_view type = "tcp");
 
-    // 从URL解析TrojanNode
-    static TrojanNode* parseFromUrl(const std::string& url);
+    // 从URL解析TrojanNode 格式不对时返回空
+    // 不输出任何信息 可能在解析线程里被调用 失败由调用方统一报告
+    static std::optional<TrojanNode> parseFromUrl(std::string_view url);
 
     // Getter和Setter
-    std::string getSni() const;
-    std::string getType() const;
-    std::string getExtraParam(const std::string& key) const;
+    std::string_view getSni() const;
+    std::string_view getType() const;
+    std::string_view getExtraParam(std::string_view key) const;
+    // 全部额外参数 存数据库时用
+    const ParamList& getExtraParams() const;
 
-    void setSni(const std::string& sni);
-    void setType(const std::string& type);
-    void setExtraParam(const std::string& key, const std::string& value);
+    void setSni(std::string_view sni);
+    void setType(std::string_view type);
+    void setExtraParam(std::string_view key, std::string_view value);
 
     // 生成Xray配置的JSON片段
-    std::string toXrayConfig() const;
+    // 直接写进调用方配置树里的outbound 不再先转成字符串
+    void toXrayConfig(nlohmann::json& outbound) const;
+
+   protected:
+    // 参与指纹和内容哈希计算的参数
+    void appendIdentity(std::string& out) const override;
+    void appendDetails(std::string& out) const override;
 };
 
 #endif 
\ No newline at end of file
@@ -1,159 +1,104 @@
 #include "VlessNode.h"
-#include <iostream>
-#include <regex>
-#include <sstream>
+#include "ProtocolTraits.h"
 #include <nlohmann/json.hpp>
 #include "base64.h"
+#include "share_link.h"
 
 using json = nlohmann::json;
 
-VlessNode::VlessNode(std::string uuid, std::string addr, int port, std::string info,
-                     std::string type, std::string encryption, std::string security)
-    : Node("vless", uuid, addr, port, info), 
-      type(type), 
-      encryption(encryption), 
-      security(security) {
+VlessNode::VlessNode(std::string_view uuid, std::string_view addr, int port, std::string_view info,
+                     std::string_view type, std::string_view encryption, std::string_view security)
+    : Node(ProtocolTraits<VlessNode>::name, uuid, addr, port, info) {
+    setType(type);
+    setEncryption(encryption);
+    setSecurity(security);
 }
 
-VlessNode* VlessNode::parseFromUrl(const std::string& url) {
+std::optional<VlessNode> VlessNode::parseFromUrl(std::string_view url) {
     // vless://uuid@addr:port?type=tcp&encryption=none&security=none#info
-    std::regex vlessRegex(R"(vless://([^@]+)@([^:]+):(\d+)\??([^#]*)(?:#(.*))?)", std::regex::ECMAScript);
-    std::smatch match;
-
-    if (!std::regex_match(url, match, vlessRegex)) {
-        std::cerr << "不是有效的VLESS URL: " << url << std::endl;
-        return nullptr;
+    ShareLink link;
+    if (!parseShareLink(url, link) || !schemeIs(link, "vless")) {
+        return std::nullopt;
     }
 
-    std::string uuid = match[1].str();
-    std::string addr = match[2].str();
-    int port = std::stoi(match[3].str());
-    std::string params = match[4].str();
-    std::string info = match[5].str();
-
-    // URL解码info (处理中文和特殊字符)
-    info = urlDecode(info);
-
-    // 使用默认值创建节点
-    VlessNode* node = new VlessNode(uuid, addr, port, info);
-
-    // 解析参数
-    if (!params.empty()) {
-        std::stringstream ss(params);
-        std::string param;
-
-        while (std::getline(ss, param, '&')) {
-            size_t pos = param.find('=');
-            if (pos != std::string::npos) {
-                std::string key = param.substr(0, pos);
-                std::string value = param.substr(pos + 1);
-                
-                // URL解码参数值
-                value = urlDecode(value);
-
-                if (key == "type") {
-                    node->setType(value);
-                } else if (key == "encryption") {
-                    node->setEncryption(value);
-                } else if (key == "security") {
-                    node->setSecurity(value);
-                } else if (key == "flow") {
-                    node->setExtraParam("flow", value);
-                } else if (key == "sni") {
-                    node->setExtraParam("sni", value);
-                } else if (key == "pbk" || key == "publicKey") {
-                    node->setExtraParam("pbk", value);
-                } else if (key == "sid" || key == "shortId") {
-                    node->setExtraParam("sid", value);
-                } else if (key == "fp" || key == "fingerprint") {
-                    node->setExtraParam("fp", value);
-                } else if (key == "host") {
-                    node->setExtraParam("host", value);
-                } else if (key == "path") {
-                    node->setExtraParam("path", value);
-                } else if (key == "alpn") {
-                    node->setExtraParam("alpn", value);
-                } else if (key == "headerType") {
-                    node->setExtraParam("headerType", value);
-                } else if (key == "quicSecurity") {
-                    node->setExtraParam("quicSecurity", value);
-                } else if (key == "serviceName") {
-                    node->setExtraParam("serviceName", value);
-                } else {
-                    // 存储其他参数
-                    node->setExtraParam(key, value);
-                }
-            }
+    // 使用默认值创建节点 info要解码(处理中文和特殊字符)
+    VlessNode node(link.userinfo, link.host, link.port,
+                   percentDecode(link.fragment));
+
+    // 解析参数 别名统一存成短的写法
+    forEachQueryParam(link.query, [&node](QueryKey key, std::string_view name, std::string_view raw) {
+        std::string value = percentDecode(raw);
+        switch (key) {
+            case QueryKey::Type: node.setType(value); break;
+            case QueryKey::Encryption: node.setEncryption(value); break;
+            case QueryKey::Security: node.setSecurity(value); break;
+            case QueryKey::PublicKey: node.setExtraParam("pbk", value); break;
+            case QueryKey::ShortId: node.setExtraParam("sid", value); break;
+            case QueryKey::Fingerprint: node.setExtraParam("fp", value); break;
+            default:
+                // 其他参数按原来的键存储
+                node.setExtraParam(name, value);
+                break;
         }
-    }
+    });
 
     return node;
 }
 
-// URL解码函数
-std::string VlessNode::urlDecode(const std::string& encoded) {
-    std::string result;
-    char ch;
-    int i, j, len = encoded.length();
-    
-    for (i = 0; i < len; i++) {
-        if (encoded[i] == '%') {
-            if (i + 2 < len) {
-                std::string hex = encoded.substr(i + 1, 2);
-                int value = 0;
-                std::istringstream(hex) >> std::hex >> value;
-                ch = static_cast<char>(value);
-                result += ch;
-                i += 2;
-            }
-        } else if (encoded[i] == '+') {
-            result += ' ';
-        } else {
-            result += encoded[i];
-        }
-    }
-    
-    return result;
+std::string_view VlessNode::getType() const {
+    return getToken(type, kTypeToken);
 }
 
-std::string VlessNode::getType() const {
-    return type;
+std::string_view VlessNode::getEncryption() const {
+    return getToken(encryption, kEncryptionToken);
 }
 
-std::string VlessNode::getEncryption() const {
-    return encryption;
+std::string_view VlessNode::getSecurity() const {
+    return getToken(security, kSecurityToken);
 }
 
-std::string VlessNode::getSecurity() const {
-    return security;
+std::string_view VlessNode::getExtraParam(std::string_view key) const {
+    return extra_params.get(key);
 }
 
-std::string VlessNode::getExtraParam(const std::string& key) const {
-    auto it = extra_params.find(key);
-    if (it != extra_params.end()) {
-        return it->second;
-    }
-    return "";
+const ParamList& VlessNode::getExtraParams() const {
+    return extra_params;
 }
 
-void VlessNode::setType(const std::string& type) {
-    this->type = type;
+void VlessNode::setType(std::string_view type) {
+    setToken(this->type, kTypeToken, type);
 }
 
-void VlessNode::setEncryption(const std::string& encryption) {
-    this->encryption = encryption;
+void VlessNode::setEncryption(std::string_view encryption) {
+    setToken(this->encryption, kEncryptionToken, encryption);
 }
 
-void VlessNode::setSecurity(const std::string& security) {
-    this->security = security;
+void VlessNode::setSecurity(std::string_view security) {
+    setToken(this->security, kSecurityToken, security);
 }
 
-void VlessNode::setExtraParam(const std::string& key, const std::string& value) {
-    extra_params[key] = value;
+void VlessNode::setExtraParam(std::string_view key, std::string_view value) {
+    extra_params.set(key, value);
 }
 
-std::string VlessNode::toXrayConfig() const {
-    json outbound = {
+void VlessNode::appendIdentity(std::string& out) const {
+    appendField(out, getToken(type, kTypeToken));
+    appendField(out, getToken(security, kSecurityToken));
+    appendField(out, getExtraParam("path"));
+    appendField(out, getExtraParam("host"));
+    appendField(out, getExtraParam("serviceName"));
+}
+
+void VlessNode::appendDetails(std::string& out) const {
+    appendField(out, getToken(encryption, kEncryptionToken));
+    for (const auto& param : extra_params) {
+        appendField(out, param.key);
+        appendField(out, param.value);
+    }
+}
+
+void VlessNode::toXrayConfig(json& outbound) const {
+    outbound = {
         {"protocol", "vless"},
         {"settings", {
             {"vnext", json::array({
@@ -176,6 +121,11 @@ std::string VlessNode::toXrayConfig() const {
         {"tag", "proxy"}
     };
 
+    // xtls-rprx-vision等流控 reality节点一般都要带上
+    if (!getExtraParam("flow").empty()) {
+        outbound["settings"]["vnext"][0]["users"][0]["flow"] = getExtraParam("flow");
+    }
+
     // 添加传输特定配置
     json& streamSettings = outbound["streamSettings"];
     
@@ -226,6 +176,4 @@ std::string VlessNode::toXrayConfig() const {
             streamSettings["realitySettings"]["fingerprint"] = getExtraParam("fp");
         }
     }
-
-    return outbound.dump(4);
 }
@@ -2,7 +2,10 @@
 #define VLESSNODE_H
 #include "Node.h"
 #include <string>
-#include <map>
+#include <string_view>
+#include "ParamList.h"
+#include <optional>
+#include <nlohmann/json_fwd.hpp>
 
 /* vless协议的节点的实体类
  字段标准按照https://github.com/XTLS/Xray-core/discussions/716设定
@@ -20,20 +23,23 @@
  */
 class VlessNode : public Node {
    private:
+    // 下面三个字段的值不认识时存在Node的文字里 这是它们各自的段号
+    enum OwnText { kTypeToken, kEncryptionToken, kSecurityToken };
+
     // 协议相关段
     // 传输方式  有tcp kcp ws http grpc httpupgrade xhttp
-    std::string type;
+    InternedString type;
 
     /* 当协议为 VLESS 时，对应配置文件出站中 settings.encryption，当前可选值只有
      * none。 省略时默认为 none，但不可以为空字符串。
      */
-    std::string encryption;
+    InternedString encryption;
 
     // 传输层相关段
     /* 底层传输安全 可选none tls reality
      * 如果没有这个字段 默认为none
      */
-    std::string security;
+    InternedString security;
 
     /* 额外参数，存储各种可选的传输层设置，比如：
        - path: WebSocket路径
@@ -43,33 +49,39 @@ class VlessNode : public Node {
        - alpn: 应用层协议协商
        等等
      */
-    std::map<std::string, std::string> extra_params;
-
-    // URL解码工具函数
-    static std::string urlDecode(const std::string& encoded);
+    ParamList extra_params;
 
    public:
     // 构造函数
-    VlessNode(std::string uuid, std::string addr, int port, std::string info,
-             std::string type = "tcp", std::string encryption = "none", 
-             std::string security = "none");
+    VlessNode(std::string_view uuid, std::string_view addr, int port, std::string_view info,
+             std::string_view type = "tcp", std::string_view encryption = "none", 
+             std::string_view security = "none");
 
-    // 从URL解析VlessNode
-    static VlessNode* parseFromUrl(const std::string& url);
+    // 从URL解析VlessNode 格式不对时返回空
+    // 不输出任何信息 可能在解析线程里被调用 失败由调用方统一报告
+    static std::optional<VlessNode> parseFromUrl(std::string_view url);
 
     // Getter和Setter
-    std::string getType() const;
-    std::string getEncryption() const;
-    std::string getSecurity() const;
-    std::string getExtraParam(const std::string& key) const;
+    std::string_view getType() const;
+    std::string_view getEncryption() const;
+    std::string_view getSecurity() const;
+    std::string_view getExtraParam(std::string_view key) const;
+    // 全部额外参数 存数据库时用
+    const ParamList& getExtraParams() const;
 
-    void setType(const std::string& type);
-    void setEncryption(const std::string& encryption);
-    void setSecurity(const std::string& security);
-    void setExtraParam(const std::string& key, const std::string& value);
+    void setType(std::string_view type);
+    void setEncryption(std::string_view encryption);
+    void setSecurity(std::string_view security);
+    void setExtraParam(std::string_view key, std::string_view value);
 
     // 生成Xray配置的JSON片段
-    std::string toXrayConfig() const;
+    // 直接写进调用方配置树里的outbound 不再先转成字符串
+    void toXrayConfig(nlohmann::json& outbound) const;
+
+   protected:
+    // 参与指纹和内容哈希计算的参数
+    void appendIdentity(std::string& out) const override;
+    void appendDetails(std::string& out) const override;
 };
 
 #endif
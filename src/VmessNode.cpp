@@ -1,126 +1,305 @@
 #include "VmessNode.h"
+#include "ProtocolTraits.h"
 #include <iostream>
-#include <regex>
-#include <sstream>
+#include <vector>
 #include <nlohmann/json.hpp>
 #include "base64.h"
 
 using json = nlohmann::json;
 
-VmessNode::VmessNode(std::string uuid, std::string addr, int port, std::string info,
-                     int alterId, std::string security, std::string type, std::string tls)
-    : Node("vmess", uuid, addr, port, info), 
-      alterId(alterId), 
-      security(security),
-      type(type),
-      tls(tls) {
+VmessNode::VmessNode(std::string_view uuid, std::string_view addr, int port, std::string_view info,
+                     int alterId, std::string_view security, std::string_view type, std::string_view tls)
+    : Node(ProtocolTraits<VmessNode>::name, uuid, addr, port, info), 
+      alterId(alterId) {
+    setSecurity(security);
+    setType(type);
+    setTls(tls);
 }
 
-VmessNode* VmessNode::parseFromUrl(const std::string& url) {
-    // VMess链接格式：vmess://base64编码的json
-    // 首先检查前缀
-    if (url.substr(0, 8) != "vmess://") {
-        std::cerr << "不是有效的VMess URL: " << url << std::endl;
+namespace {
+
+// 按逗号切开 片段直接指向原字符串 切法和原来的getline一样(末尾的逗号不多出一个空项)
+std::vector<std::string_view> splitList(std::string_view text) {
+    std::vector<std::string_view> items;
+    while (!text.empty()) {
+        size_t comma = text.find(',');
+        items.push_back(text.substr(0, comma));
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        text.remove_prefix(comma + 1);
+    }
+    return items;
+}
+
+// vmess链接里关心的字段 没有出现的保持空
+struct VmessFields {
+    std::string id;
+    std::string add;
+    std::string port;
+    std::string ps;
+    std::string aid;
+    std::string scy;
+    std::string net;
+    std::string tls;
+    std::string host;
+    std::string path;
+    std::string sni;
+    std::string alpn;
+};
+
+// nlohmann::json的SAX回调 只把顶层已知键的值收进VmessFields 不建DOM
+// 字符串和数字都接受 数字转成文本 由调用方再按需要转换
+// 出错时返回false让解析停下来 不抛异常
+class VmessFieldCollector {
+   public:
+    using number_integer_t = json::number_integer_t;
+    using number_unsigned_t = json::number_unsigned_t;
+    using number_float_t = json::number_float_t;
+    using string_t = json::string_t;
+    using binary_t = json::binary_t;
+
+    explicit VmessFieldCollector(VmessFields& fields) : fields(fields) {}
+
+    bool null() { return value(nullptr); }
+    bool boolean(bool val) { return value(val ? "true" : "false"); }
+    bool number_integer(number_integer_t val) { return value(std::to_string(val)); }
+    bool number_unsigned(number_unsigned_t val) { return value(std::to_string(val)); }
+    bool number_float(number_float_t, const string_t& text) { return value(text); }
+    bool string(string_t& val) { return value(std::move(val)); }
+    bool binary(binary_t&) { return value(nullptr); }
+
+    bool start_object(std::size_t) {
+        depth++;
+        return true;
+    }
+    bool end_object() {
+        depth--;
+        target = nullptr;
+        return true;
+    }
+    bool start_array(std::size_t) {
+        // 数组里的东西都不要
+        depth++;
+        return true;
+    }
+    bool end_array() {
+        depth--;
+        target = nullptr;
+        return true;
+    }
+
+    bool key(string_t& name) {
+        target = depth == 1 ? lookup(name) : nullptr;
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception&) { return false; }
+
+   private:
+    VmessFields& fields;
+    std::string* target = nullptr;  // 下一个值要写到哪里 未知键为空
+    int depth = 0;  // 当前嵌套层数 顶层对象里是1
+
+    std::string* lookup(const std::string& name) {
+        if (name == "id") return &fields.id;
+        if (name == "add") return &fields.add;
+        if (name == "port") return &fields.port;
+        if (name == "ps") return &fields.ps;
+        if (name == "aid") return &fields.aid;
+        if (name == "scy") return &fields.scy;
+        if (name == "net") return &fields.net;
+        if (name == "tls") return &fields.tls;
+        if (name == "host") return &fields.host;
+        if (name == "path") return &fields.path;
+        if (name == "sni") return &fields.sni;
+        if (name == "alpn") return &fields.alpn;
         return nullptr;
     }
-    
-    // 提取base64部分并解码
-    std::string base64_str = url.substr(8);
-    std::string json_str = base64_decode(base64_str);
-    
-    try {
-        // 解析JSON
-        json vmess_json = json::parse(json_str);
-        
-        // 提取必要字段
-        std::string uuid = vmess_json.value("id", "");
-        std::string addr = vmess_json.value("add", "");
-        int port = vmess_json.value("port", 0);
-        std::string ps = vmess_json.value("ps", "");
-        int aid = vmess_json.value("aid", 0);
-        std::string security = vmess_json.value("scy", "auto");  // 默认auto
-        std::string net = vmess_json.value("net", "tcp");        // 默认tcp
-        std::string tls = vmess_json.value("tls", "");
-        
-        // 检查必要字段
-        if (uuid.empty() || addr.empty() || port == 0) {
-            std::cerr << "VMess节点缺少必要字段" << std::endl;
-            return nullptr;
-        }
-        
-        // 创建VMess节点
-        VmessNode* node = new VmessNode(uuid, addr, port, ps, aid, security, net, tls);
-        
-        // 设置额外参数
-        if (vmess_json.contains("host")) {
-            node->setExtraParam("host", vmess_json["host"]);
-        }
-        
-        if (vmess_json.contains("path")) {
-            node->setExtraParam("path", vmess_json["path"]);
+
+    bool value(std::nullptr_t) {
+        target = nullptr;
+        return true;
+    }
+
+    bool value(std::string text) {
+        // 只有顶层键紧跟着的标量才算数
+        if (depth == 1 && target) {
+            *target = std::move(text);
         }
-        
-        if (vmess_json.contains("alpn")) {
-            node->setExtraParam("alpn", vmess_json["alpn"]);
+        target = nullptr;
+        return true;
+    }
+};
+
+// 把"443" 443 443.0这几种写法都转成整数 范围是[0, max]
+bool parseVmessInt(const std::string& text, int max, int& out) {
+    if (text.empty()) {
+        return false;
+    }
+    long value = 0;
+    size_t i = 0;
+    for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++) {
+        value = value * 10 + (text[i] - '0');
+        if (value > max) {
+            return false;
         }
-        
-        if (vmess_json.contains("sni")) {
-            node->setExtraParam("sni", vmess_json["sni"]);
+    }
+    if (i == 0) {
+        return false;
+    }
+    // 允许小数点后面全是0
+    if (i < text.size() && text[i] == '.') {
+        for (i++; i < text.size() && text[i] == '0'; i++) {
         }
-        
-        return node;
-    } catch (const std::exception& e) {
-        std::cerr << "解析VMess URL失败: " << e.what() << std::endl;
-        return nullptr;
     }
+    if (i != text.size()) {
+        return false;
+    }
+    out = static_cast<int>(value);
+    return true;
+}
+
+}  // namespace
+
+VmessNode::ParseStatus VmessNode::tryParse(std::string_view url, std::optional<VmessNode>& node) {
+    node.reset();
+
+    // VMess链接格式：vmess://base64编码的json
+    if (url.substr(0, 8) != "vmess://") {
+        return ParseStatus::NotVmess;
+    }
+
+    std::string json_str;
+    if (!base64_try_decode(url.substr(8), json_str)) {
+        return ParseStatus::BadBase64;
+    }
+
+    VmessFields fields;
+    VmessFieldCollector collector(fields);
+    if (!json::sax_parse(json_str, &collector)) {
+        return ParseStatus::BadJson;
+    }
+
+    // 检查必要字段
+    if (fields.id.empty() || fields.add.empty()) {
+        return ParseStatus::MissingField;
+    }
+    int port = 0;
+    if (!parseVmessInt(fields.port, 65535, port) || port == 0) {
+        return ParseStatus::BadPort;
+    }
+    // aid不合法时按0处理 现在的服务端基本都是0
+    int aid = 0;
+    if (!fields.aid.empty() && !parseVmessInt(fields.aid, 65535, aid)) {
+        aid = 0;
+    }
+
+    node.emplace(std::move(fields.id), std::move(fields.add), port, std::move(fields.ps), aid,
+                 fields.scy.empty() ? "auto" : std::move(fields.scy),  // 默认auto
+                 fields.net.empty() ? "tcp" : std::move(fields.net),   // 默认tcp
+                 std::move(fields.tls));
+
+    // 设置额外参数 空值不存
+    if (!fields.host.empty()) {
+        node->setExtraParam("host", fields.host);
+    }
+    if (!fields.path.empty()) {
+        node->setExtraParam("path", fields.path);
+    }
+    if (!fields.alpn.empty()) {
+        node->setExtraParam("alpn", fields.alpn);
+    }
+    if (!fields.sni.empty()) {
+        node->setExtraParam("sni", fields.sni);
+    }
+    return ParseStatus::Ok;
+}
+
+const char* VmessNode::describe(ParseStatus status) {
+    switch (status) {
+        case ParseStatus::Ok: return "成功";
+        case ParseStatus::NotVmess: return "不是有效的VMess URL";
+        case ParseStatus::BadBase64: return "VMess链接不是有效的base64编码";
+        case ParseStatus::BadJson: return "VMess链接里的JSON格式不对";
+        case ParseStatus::MissingField: return "VMess节点缺少必要字段";
+        case ParseStatus::BadPort: return "VMess节点的端口不合法";
+    }
+    return "未知错误";
+}
+
+std::optional<VmessNode> VmessNode::parseFromUrl(std::string_view url) {
+    std::optional<VmessNode> node;
+    ParseStatus status = tryParse(url, node);
+    if (status != ParseStatus::Ok) {
+        std::cerr << describe(status) << ": " << url.substr(0, 50) << "..." << std::endl;
+    }
+    return node;
 }
 
 int VmessNode::getAlterId() const {
     return alterId;
 }
 
-std::string VmessNode::getSecurity() const {
-    return security;
+std::string_view VmessNode::getSecurity() const {
+    return getToken(security, kSecurityToken);
 }
 
-std::string VmessNode::getType() const {
-    return type;
+std::string_view VmessNode::getType() const {
+    return getToken(type, kTypeToken);
 }
 
-std::string VmessNode::getTls() const {
-    return tls;
+std::string_view VmessNode::getTls() const {
+    return getToken(tls, kTlsToken);
 }
 
-std::string VmessNode::getExtraParam(const std::string& key) const {
-    auto it = extra_params.find(key);
-    if (it != extra_params.end()) {
-        return it->second;
-    }
-    return "";
+std::string_view VmessNode::getExtraParam(std::string_view key) const {
+    return extra_params.get(key);
+}
+
+const ParamList& VmessNode::getExtraParams() const {
+    return extra_params;
 }
 
 void VmessNode::setAlterId(int alterId) {
     this->alterId = alterId;
 }
 
-void VmessNode::setSecurity(const std::string& security) {
-    this->security = security;
+void VmessNode::setSecurity(std::string_view security) {
+    setToken(this->security, kSecurityToken, security);
+}
+
+void VmessNode::setType(std::string_view type) {
+    setToken(this->type, kTypeToken, type);
 }
 
-void VmessNode::setType(const std::string& type) {
-    this->type = type;
+void VmessNode::setTls(std::string_view tls) {
+    setToken(this->tls, kTlsToken, tls);
 }
 
-void VmessNode::setTls(const std::string& tls) {
-    this->tls = tls;
+void VmessNode::setExtraParam(std::string_view key, std::string_view value) {
+    extra_params.set(key, value);
 }
 
-void VmessNode::setExtraParam(const std::string& key, const std::string& value) {
-    extra_params[key] = value;
+void VmessNode::appendIdentity(std::string& out) const {
+    appendField(out, getToken(type, kTypeToken));
+    appendField(out, getToken(tls, kTlsToken));
+    appendField(out, getExtraParam("path"));
+    appendField(out, getExtraParam("host"));
+    appendField(out, getExtraParam("serviceName"));
 }
 
-std::string VmessNode::toXrayConfig() const {
-    json outbound = {
+void VmessNode::appendDetails(std::string& out) const {
+    appendField(out, std::to_string(alterId));
+    appendField(out, getToken(security, kSecurityToken));
+    for (const auto& param : extra_params) {
+        appendField(out, param.key);
+        appendField(out, param.value);
+    }
+}
+
+void VmessNode::toXrayConfig(json& outbound) const {
+    outbound = {
         {"protocol", "vmess"},
         {"settings", {
             {"vnext", json::array({
@@ -156,10 +335,8 @@ std::string VmessNode::toXrayConfig() const {
         
         if (!getExtraParam("alpn").empty()) {
             json alpn = json::array();
-            std::istringstream iss(getExtraParam("alpn"));
-            std::string alpn_item;
-            while (std::getline(iss, alpn_item, ',')) {
-                alpn.push_back(alpn_item);
+            for (std::string_view item : splitList(getExtraParam("alpn"))) {
+                alpn.push_back(item);
             }
             tlsSettings["alpn"] = alpn;
         }
@@ -199,10 +376,8 @@ std::string VmessNode::toXrayConfig() const {
         
         if (!getExtraParam("host").empty()) {
             json hosts = json::array();
-            std::istringstream iss(getExtraParam("host"));
-            std::string host_item;
-            while (std::getline(iss, host_item, ',')) {
-                hosts.push_back(host_item);
+            for (std::string_view item : splitList(getExtraParam("host"))) {
+                hosts.push_back(item);
             }
             httpSettings["host"] = hosts;
         }
@@ -219,6 +394,4 @@ std::string VmessNode::toXrayConfig() const {
         };
         streamSettings["quicSettings"] = quicSettings;
     }
-    
-    return outbound.dump(4);
 } 
\ No newline at end of file
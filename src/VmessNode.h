@@ -2,7 +2,10 @@
 #define VMESSNODE_H
 #include "Node.h"
 #include <string>
-#include <map>
+#include <string_view>
+#include "ParamList.h"
+#include <optional>
+#include <nlohmann/json_fwd.hpp>
 
 /* vmess协议的节点的实体类
  * 父类Node已有以下几个属性...
@@ -15,43 +18,71 @@
  */
 class VmessNode : public Node {
    private:
+    // 值不认识时存在Node的文字里的段号
+    enum OwnText { kSecurityToken, kTypeToken, kTlsToken };
+
     // 协议相关段
     int alterId;  // alterID
-    std::string security;  // 加密方式 auto, aes-128-gcm, chacha20-poly1305, none 等
+    InternedString security;  // 加密方式 auto, aes-128-gcm, chacha20-poly1305, none 等
 
     // 传输方式  有tcp kcp ws http grpc httpupgrade quic 等
-    std::string type;
+    InternedString type;
 
     // 传输层安全
-    std::string tls;  // tls 或 空
+    InternedString tls;  // tls 或 空
 
     // 额外参数
-    std::map<std::string, std::string> extra_params;
+    ParamList extra_params;
 
    public:
     // 构造函数
-    VmessNode(std::string uuid, std::string addr, int port, std::string info,
-             int alterId = 0, std::string security = "auto", 
-             std::string type = "tcp", std::string tls = "");
+    VmessNode(std::string_view uuid, std::string_view addr, int port, std::string_view info,
+             int alterId = 0, std::string_view security = "auto", 
+             std::string_view type = "tcp", std::string_view tls = "");
+
+    // 解析vmess链接的结果
+    enum class ParseStatus {
+        Ok,
+        NotVmess,      // 不是vmess://开头
+        BadBase64,     // base64解码失败
+        BadJson,       // 解码后不是JSON对象
+        MissingField,  // 没有id或add
+        BadPort,       // 端口缺失或不在1~65535
+    };
+
+    // 从URL解析VmessNode (vmess://base64) 成功时结果放进node 失败时node为空
+    // 不抛异常 也不打印 port和aid写成字符串或数字都可以
+    static ParseStatus tryParse(std::string_view url, std::optional<VmessNode>& node);
 
-    // 从URL解析VmessNode (vmess://base64)
-    static VmessNode* parseFromUrl(const std::string& url);
+    // 错误码对应的中文说明
+    static const char* describe(ParseStatus status);
+
+    // 同tryParse 失败时打印原因并返回空
+    static std::optional<VmessNode> parseFromUrl(std::string_view url);
 
     // Getter和Setter
     int getAlterId() const;
-    std::string getSecurity() const;
-    std::string getType() const;
-    std::string getTls() const;
-    std::string getExtraParam(const std::string& key) const;
+    std::string_view getSecurity() const;
+    std::string_view getType() const;
+    std::string_view getTls() const;
+    std::string_view getExtraParam(std::string_view key) const;
+    // 全部额外参数 存数据库时用
+    const ParamList& getExtraParams() const;
 
     void setAlterId(int alterId);
-    void setSecurity(const std::string& security);
-    void setType(const std::string& type);
-    void setTls(const std::string& tls);
-    void setExtraParam(const std::string& key, const std::string& value);
+    void setSecurity(std::string_view security);
+    void setType(std::string_view type);
+    void setTls(std::string_view tls);
+    void setExtraParam(std::string_view key, std::string_view value);
 
     // 生成Xray配置的JSON片段
-    std::string toXrayConfig() const;
+    // 直接写进调用方配置树里的outbound 不再先转成字符串
+    void toXrayConfig(nlohmann::json& outbound) const;
+
+   protected:
+    // 参与指纹和内容哈希计算的参数
+    void appendIdentity(std::string& out) const override;
+    void appendDetails(std::string& out) const override;
 };
 
 #endif 
\ No newline at end of file
@@ -31,11 +31,23 @@
 
 */
 
+/*
+   Altered source version: the heresy project appended a non-throwing,
+   incremental decoder with SSE4.1/AVX2 fast paths at the end of this file
+   (base64_decode_append and friends). The original functions are unchanged.
+*/
+
 #include "base64.h"
 
 #include <algorithm>
+#include <atomic>
 #include <stdexcept>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HERESY_BASE64_X86 1
+#include <immintrin.h>
+#endif
+
  //
  // Depending on the url parameter in base64_chars, one of
  // two sets of base64 characters needs to be chosen.
@@ -279,4 +291,279 @@ std::string base64_decode(std::string_view s, bool remove_linebreaks) {
    return decode(s, remove_linebreaks);
 }
 
+//
+// heresy追加的实现
+//
+// 思路: 数据里绝大部分是连续的字母表字符 这部分交给SIMD整块解码
+// 遇到空白 换行 填充和数据块边界时退回到逐字符的状态机
+//
+namespace {
+
+const signed char kInvalid = -1;
+const signed char kSkip    = -2;  // 空白和换行
+const signed char kPadding = -3;  // '='和'.' 结束当前这组
+
+struct decode_table_t {
+   signed char v[256];
+};
+
+constexpr decode_table_t make_decode_table() {
+   decode_table_t table{};
+   for (int i = 0; i < 256; i++) table.v[i] = kInvalid;
+   for (int i = 0; i < 26; i++) {
+      table.v['A' + i] = static_cast<signed char>(i);
+      table.v['a' + i] = static_cast<signed char>(26 + i);
+   }
+   for (int i = 0; i < 10; i++) table.v['0' + i] = static_cast<signed char>(52 + i);
+   table.v['+']  = 62;
+   table.v['-']  = 62;
+   table.v['/']  = 63;
+   table.v['_']  = 63;
+   table.v['=']  = kPadding;
+   table.v['.']  = kPadding;
+   table.v[' ']  = kSkip;
+   table.v['\t'] = kSkip;
+   table.v['\r'] = kSkip;
+   table.v['\n'] = kSkip;
+   return table;
+}
+
+constexpr decode_table_t decode_table = make_decode_table();
+
+// SIMD实现一次最多会多写这么多字节 输出缓冲区要留出余量
+const size_t kOutputSlack = 32;
+
+//
+// 解码从in开始的连续完整4字符组 遇到不在字母表里的字符就停下
+// 返回消耗的输入字符数(总是4的倍数) 写出的字节数放在*written
+//
+using decode_run_fn = size_t (*)(const unsigned char* in, size_t len, unsigned char* out, size_t* written);
+
+size_t decode_run_scalar(const unsigned char* in, size_t len, unsigned char* out, size_t* written) {
+   size_t pos = 0;
+   size_t w   = 0;
+   while (pos + 4 <= len) {
+      int a = decode_table.v[in[pos + 0]];
+      int b = decode_table.v[in[pos + 1]];
+      int c = decode_table.v[in[pos + 2]];
+      int d = decode_table.v[in[pos + 3]];
+      // 所有特殊值都是负数 一次判断就够了
+      if ((a | b | c | d) < 0) break;
+
+      unsigned int v = (static_cast<unsigned int>(a) << 18) | (b << 12) | (c << 6) | d;
+      out[w + 0] = static_cast<unsigned char>(v >> 16);
+      out[w + 1] = static_cast<unsigned char>(v >> 8);
+      out[w + 2] = static_cast<unsigned char>(v);
+      pos += 4;
+      w   += 3;
+   }
+   *written = w;
+   return pos;
+}
+
+#ifdef HERESY_BASE64_X86
+
+//
+// 16个字符 -> 12个字节
+// 用区间比较同时识别两套字母表 任何一个字符不合法就交给标量实现
+// 写出16个字节 其中后4个是无效的
+//
+__attribute__((target("sse4.1")))
+size_t decode_run_sse41(const unsigned char* in, size_t len, unsigned char* out, size_t* written) {
+   size_t pos = 0;
+   size_t w   = 0;
+
+   const __m128i pack_pairs  = _mm_set1_epi32(0x01400140);
+   const __m128i pack_quads  = _mm_set1_epi32(0x00011000);
+   const __m128i pack_bytes  = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+   while (pos + 16 <= len) {
+      __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + pos));
+
+      __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+      __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('z' + 1)));
+      __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+      __m128i plus  = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('+')), _mm_cmpeq_epi8(c, _mm_set1_epi8('-')));
+      __m128i slash = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('/')), _mm_cmpeq_epi8(c, _mm_set1_epi8('_')));
+
+      __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, plus), slash));
+      if (_mm_movemask_epi8(valid) != 0xFFFF) break;
+
+      __m128i v = _mm_and_si128(upper, _mm_sub_epi8(c, _mm_set1_epi8('A')));
+      v = _mm_or_si128(v, _mm_and_si128(lower, _mm_sub_epi8(c, _mm_set1_epi8('a' - 26))));
+      v = _mm_or_si128(v, _mm_and_si128(digit, _mm_add_epi8(c, _mm_set1_epi8(52 - '0'))));
+      v = _mm_or_si128(v, _mm_and_si128(plus, _mm_set1_epi8(62)));
+      v = _mm_or_si128(v, _mm_and_si128(slash, _mm_set1_epi8(63)));
+
+      // 每4个6位值拼成一个24位整数 再按大端顺序取出3个字节
+      __m128i merged = _mm_maddubs_epi16(v, pack_pairs);
+      __m128i packed = _mm_madd_epi16(merged, pack_quads);
+      __m128i bytes  = _mm_shuffle_epi8(packed, pack_bytes);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + w), bytes);
+
+      pos += 16;
+      w   += 12;
+   }
+
+   size_t tail = 0;
+   pos += decode_run_scalar(in + pos, len - pos, out + w, &tail);
+   *written = w + tail;
+   return pos;
+}
+
+//
+// 32个字符 -> 24个字节 做法和SSE版本一样 最后把两条128位通道的结果并到一起
+// 写出32个字节 其中后8个是无效的
+//
+__attribute__((target("avx2")))
+size_t decode_run_avx2(const unsigned char* in, size_t len, unsigned char* out, size_t* written) {
+   size_t pos = 0;
+   size_t w   = 0;
+
+   const __m256i pack_pairs  = _mm256_set1_epi32(0x01400140);
+   const __m256i pack_quads  = _mm256_set1_epi32(0x00011000);
+   const __m256i pack_bytes  = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+   const __m256i pack_lanes  = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+   while (pos + 32 <= len) {
+      __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + pos));
+
+      __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), c));
+      __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), c));
+      __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+      __m256i plus  = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('+')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('-')));
+      __m256i slash = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('/')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('_')));
+
+      __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(_mm256_or_si256(digit, plus), slash));
+      if (_mm256_movemask_epi8(valid) != -1) break;
+
+      __m256i v = _mm256_and_si256(upper, _mm256_sub_epi8(c, _mm256_set1_epi8('A')));
+      v = _mm256_or_si256(v, _mm256_and_si256(lower, _mm256_sub_epi8(c, _mm256_set1_epi8('a' - 26))));
+      v = _mm256_or_si256(v, _mm256_and_si256(digit, _mm256_add_epi8(c, _mm256_set1_epi8(52 - '0'))));
+      v = _mm256_or_si256(v, _mm256_and_si256(plus, _mm256_set1_epi8(62)));
+      v = _mm256_or_si256(v, _mm256_and_si256(slash, _mm256_set1_epi8(63)));
+
+      __m256i merged = _mm256_maddubs_epi16(v, pack_pairs);
+      __m256i packed = _mm256_madd_epi16(merged, pack_quads);
+      __m256i bytes  = _mm256_shuffle_epi8(packed, pack_bytes);
+      bytes = _mm256_permutevar8x32_epi32(bytes, pack_lanes);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + w), bytes);
+
+      pos += 32;
+      w   += 24;
+   }
+
+   size_t tail = 0;
+   pos += decode_run_sse41(in + pos, len - pos, out + w, &tail);
+   *written = w + tail;
+   return pos;
+}
+
+#endif  // HERESY_BASE64_X86
+
+struct decode_impl_t {
+   decode_run_fn run;
+   const char*   name;
+};
+
+decode_impl_t select_decode_impl() {
+#ifdef HERESY_BASE64_X86
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2"))   return {decode_run_avx2,  "avx2"};
+   if (__builtin_cpu_supports("sse4.1")) return {decode_run_sse41, "sse4.1"};
+#endif
+   return {decode_run_scalar, "scalar"};
+}
+
+const decode_impl_t& active_decode_impl() {
+   static const decode_impl_t impl = select_decode_impl();
+   return impl;
+}
+
+std::atomic<bool> force_scalar_decode{false};
+
+// 把state里不满4个字符的部分输出 2个字符得1个字节 3个字符得2个字节
+size_t flush_partial(base64_decode_state& state, unsigned char* out) {
+   size_t w = 0;
+   if (state.count == 2) {
+      out[w++] = static_cast<unsigned char>(state.quantum >> 4);
+   } else if (state.count == 3) {
+      out[w++] = static_cast<unsigned char>(state.quantum >> 10);
+      out[w++] = static_cast<unsigned char>(state.quantum >> 2);
+   }
+   state.quantum = 0;
+   state.count   = 0;
+   return w;
+}
+
+}  // namespace
+
+bool base64_decode_append(const char* data, size_t len, base64_decode_state& state, std::string& out) {
+   const unsigned char* in = reinterpret_cast<const unsigned char*>(data);
+
+   size_t base = out.size();
+   out.resize(base + len / 4 * 3 + 3 + kOutputSlack);
+   unsigned char* dst = reinterpret_cast<unsigned char*>(&out[0]) + base;
+
+   decode_run_fn run = force_scalar_decode ? decode_run_scalar : active_decode_impl().run;
+
+   size_t pos = 0;
+   size_t w   = 0;
+   while (pos < len) {
+      if (state.count == 0) {
+         // 在4字符组的边界上 尽量让快速路径一口气解码
+         size_t n = 0;
+         pos += run(in + pos, len - pos, dst + w, &n);
+         w   += n;
+         if (pos >= len) break;
+      }
+
+      signed char v = decode_table.v[in[pos++]];
+      if (v >= 0) {
+         state.quantum = (state.quantum << 6) | static_cast<unsigned int>(v);
+         if (++state.count == 4) {
+            dst[w++] = static_cast<unsigned char>(state.quantum >> 16);
+            dst[w++] = static_cast<unsigned char>(state.quantum >> 8);
+            dst[w++] = static_cast<unsigned char>(state.quantum);
+            state.quantum = 0;
+            state.count   = 0;
+         }
+      } else if (v == kPadding) {
+         // 有的订阅是几段各自带填充的base64拼起来的 遇到填充就把这组结束掉
+         w += flush_partial(state, dst + w);
+      } else if (v == kInvalid) {
+         out.resize(base + w);
+         return false;
+      }
+   }
+
+   out.resize(base + w);
+   return true;
+}
+
+void base64_decode_finish(base64_decode_state& state, std::string& out) {
+   unsigned char tail[2];
+   size_t w = flush_partial(state, tail);
+   out.append(reinterpret_cast<const char*>(tail), w);
+}
+
+bool base64_try_decode(std::string_view s, std::string& out) {
+   out.clear();
+   base64_decode_state state;
+   if (!base64_decode_append(s.data(), s.size(), state, out)) {
+      return false;
+   }
+   base64_decode_finish(state, out);
+   return true;
+}
+
+const char* base64_decode_impl() {
+   return force_scalar_decode ? "scalar" : active_decode_impl().name;
+}
+
+void base64_force_scalar(bool force) {
+   force_scalar_decode = force;
+}
+
 #endif  // __cplusplus >= 201703L
@@ -30,6 +30,37 @@ std::string base64_encode_pem (std::string_view s);
 std::string base64_encode_mime(std::string_view s);
 
 std::string base64_decode(std::string_view s, bool remove_linebreaks = false);
+
+//
+// heresy在原版之外追加的接口(原版的函数行为保持不变)
+//
+// 不抛异常的解码 给订阅内容和vmess链接用
+// 同时接受标准和url安全两套字符 跳过空白和换行 允许缺少填充
+// 遇到其他字符时返回false
+// 在支持的CPU上(x86-64 AVX2/SSE4.1)运行时自动选择SIMD实现 否则使用标量实现
+//
+
+// 增量解码的状态 保存跨数据块的不满4个字符的部分
+struct base64_decode_state {
+   unsigned int quantum = 0;
+   int          count   = 0;
+};
+
+// 解码一块数据 结果追加到out
+bool base64_decode_append(const char* data, size_t len, base64_decode_state& state, std::string& out);
+
+// 输入结束 输出state里剩下的部分
+void base64_decode_finish(base64_decode_state& state, std::string& out);
+
+// 一次性解码s 结果放到out(会先清空)
+bool base64_try_decode(std::string_view s, std::string& out);
+
+// 当前运行时选中的实现 "avx2" "sse4.1" 或 "scalar"
+const char* base64_decode_impl();
+
+// 强制使用标量实现 性能测试对比用
+void base64_force_scalar(bool force);
+
 #endif  // __cplusplus >= 201703L
 
 #endif /* BASE64_H_C0CE2A47_D10E_42C9_A27C_C883944E704A */
@@ -0,0 +1,20 @@
+#ifndef HASH_UTIL_H
+#define HASH_UTIL_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+//这不是类 只是存放一些哈希函数的文件
+//用来判断订阅内容/节点有没有变化 不是用来做安全相关的事情的
+
+// 64位FNV-1a 可以用上一次的结果当作seed继续累加
+uint64_t fnv1a64(std::string_view data, uint64_t seed = 14695981039346656037ULL);
+
+// 把64位哈希值转成16个字符的十六进制字符串 方便存进数据库
+std::string hashToHex(uint64_t hash);
+
+// 相当于hashToHex(fnv1a64(data))
+std::string hashHex(std::string_view data);
+
+#endif
@@ -1,26 +1,286 @@
 #include "http_util.h"
 #include <curl/curl.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <mutex>
 
-size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* output) {
+namespace {
+
+// 进程内共享的curl_share句柄
+// 保存DNS缓存 连接池和TLS会话 所有easy句柄都挂在它上面
+class CurlShare {
+   public:
+    CurlShare() {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+        share = curl_share_init();
+        if (share) {
+            curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lock);
+            curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlock);
+            curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+            curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+            curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+            curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        }
+    }
+
+    ~CurlShare() {
+        if (share) {
+            curl_share_cleanup(share);
+        }
+    }
+
+    CURLSH* get() const { return share; }
+
+   private:
+    CURLSH* share = nullptr;
+    // 每种共享数据一把锁
+    std::mutex locks[CURL_LOCK_DATA_LAST];
+
+    static void lock(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+        static_cast<CurlShare*>(userptr)->locks[data].lock();
+    }
+
+    static void unlock(CURL*, curl_lock_data data, void* userptr) {
+        static_cast<CurlShare*>(userptr)->locks[data].unlock();
+    }
+};
+
+CURLSH* sharedHandle() {
+    static CurlShare instance;
+    return instance.get();
+}
+
+// 一次传输的上下文 写回调和头回调都通过它找到请求和结果
+struct Transfer {
+    CURL* curl = nullptr;
+    const DownloadRequest* request = nullptr;
+    DownloadResult* result = nullptr;
+    curl_slist* headers = nullptr;
+};
+
+size_t WriteCallback(void* contents, size_t size, size_t nmemb, Transfer* transfer) {
     size_t totalSize = size * nmemb;
-    output->append((char*)contents, totalSize);
+    if (!transfer->request->onData) {
+        transfer->result->body.append((char*)contents, totalSize);
+        return totalSize;
+    }
+
+    // 错误页面不交给调用方解析
+    long status = 0;
+    curl_easy_getinfo(transfer->curl, CURLINFO_RESPONSE_CODE, &status);
+    if (status >= 400) {
+        return totalSize;
+    }
+    // 这是curl的C回调 异常不能从这里穿出去
+    try {
+        if (!transfer->request->onData(static_cast<const char*>(contents), totalSize)) {
+            return 0;  // 让curl以写入错误结束这次传输
+        }
+    } catch (...) {
+        return 0;
+    }
     return totalSize;
 }
 
+// 不区分大小写地判断响应头的名字
+bool headerIs(const char* line, size_t len, const char* name) {
+    size_t n = std::strlen(name);
+    if (len <= n || line[n] != ':') {
+        return false;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (std::tolower(static_cast<unsigned char>(line[i])) != name[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 取出响应头冒号后面的值 去掉两边的空白
+std::string headerValue(const char* line, size_t len, size_t nameLen) {
+    size_t begin = nameLen + 1;
+    size_t end = len;
+    while (begin < end && std::isspace(static_cast<unsigned char>(line[begin]))) {
+        begin++;
+    }
+    while (end > begin && std::isspace(static_cast<unsigned char>(line[end - 1]))) {
+        end--;
+    }
+    return std::string(line + begin, end - begin);
+}
+
+// 记录ETag和Last-Modified 跟随重定向时只保留最后一个响应的
+size_t HeaderCallback(char* buffer, size_t size, size_t nitems, Transfer* transfer) {
+    DownloadResult* result = transfer->result;
+    size_t len = size * nitems;
+    if (len >= 5 && std::strncmp(buffer, "HTTP/", 5) == 0) {
+        result->etag.clear();
+        result->lastModified.clear();
+    } else if (headerIs(buffer, len, "etag")) {
+        result->etag = headerValue(buffer, len, 4);
+    } else if (headerIs(buffer, len, "last-modified")) {
+        result->lastModified = headerValue(buffer, len, 13);
+    }
+    return len;
+}
+
+// 创建easy句柄并设置公共选项 失败时返回false
+// transfer里的请求和结果要在传输结束前一直有效 请求头由releaseTransfer释放
+bool setupTransfer(Transfer& transfer, const DownloadRequest& request, DownloadResult* result) {
+    CURL* curl = curl_easy_init();
+    if (!curl) {
+        return false;
+    }
+    transfer.curl = curl;
+    transfer.request = &request;
+    transfer.result = result;
+
+    transfer.headers = nullptr;
+    if (!request.etag.empty()) {
+        transfer.headers = curl_slist_append(transfer.headers, ("If-None-Match: " + request.etag).c_str());
+    }
+    if (!request.lastModified.empty()) {
+        transfer.headers = curl_slist_append(transfer.headers, ("If-Modified-Since: " + request.lastModified).c_str());
+    }
+    if (transfer.headers) {
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer.headers);
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, request.url.c_str());
+    curl_easy_setopt(curl, CURLOPT_SHARE, sharedHandle());
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 15L);
+    // 30秒内没有任何数据就放弃 避免一个卡住的机场拖住整批更新
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 30L);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &transfer);
+    return true;
+}
+
+void releaseTransfer(Transfer& transfer) {
+    curl_easy_cleanup(transfer.curl);
+    curl_slist_free_all(transfer.headers);
+    transfer.curl = nullptr;
+    transfer.headers = nullptr;
+}
+
+// 根据传输结果填写result
+void finishResult(CURL* curl, CURLcode code, DownloadResult* result) {
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &result->status);
+    if (code != CURLE_OK) {
+        result->ok = false;
+        result->error = curl_easy_strerror(code);
+    } else if (result->status >= 400) {
+        result->ok = false;
+        result->error = "HTTP " + std::to_string(result->status);
+    } else {
+        result->ok = true;
+        result->notModified = result->status == 304;
+    }
+}
+
+}  // namespace
+
 std::string downloadFromURL(const std::string& url) {
-    CURL* curl;
-    CURLcode res;
-    std::string response;
+    DownloadRequest request;
+    request.url = url;
+    DownloadResult result = downloadFromURL(request);
 
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        res = curl_easy_perform(curl);
-        curl_easy_cleanup(curl);
+    if (!result.ok) {
+        return "";
     }
+    return result.body;
+}
 
-    return response;
+DownloadResult downloadFromURL(const DownloadRequest& request) {
+    DownloadResult result;
+    Transfer transfer;
+    if (!setupTransfer(transfer, request, &result)) {
+        result.error = "无法创建curl句柄";
+        return result;
+    }
+
+    CURLcode res = curl_easy_perform(transfer.curl);
+    finishResult(transfer.curl, res, &result);
+    releaseTransfer(transfer);
+    return result;
 }
 
+void downloadAll(const std::vector<DownloadRequest>& requests, int maxConcurrency,
+                 const std::function<void(size_t, DownloadResult&)>& onDone) {
+    if (requests.empty()) {
+        return;
+    }
+    size_t limit = static_cast<size_t>(std::max(1, maxConcurrency));
+
+    CURLM* multi = curl_multi_init();
+    if (!multi) {
+        // 退化成串行下载
+        for (size_t i = 0; i < requests.size(); i++) {
+            DownloadResult result = downloadFromURL(requests[i]);
+            onDone(i, result);
+        }
+        return;
+    }
+
+    // 每个url一个结果槽 curl句柄通过CURLOPT_PRIVATE记住自己对应的下标
+    std::vector<DownloadResult> results(requests.size());
+    std::vector<Transfer> transfers(requests.size());
+    size_t next = 0;
+    size_t active = 0;
+
+    auto startPending = [&]() {
+        while (active < limit && next < requests.size()) {
+            size_t index = next++;
+            if (!setupTransfer(transfers[index], requests[index], &results[index])) {
+                results[index].error = "无法创建curl句柄";
+                onDone(index, results[index]);
+                continue;
+            }
+            CURL* curl = transfers[index].curl;
+            curl_easy_setopt(curl, CURLOPT_PRIVATE, reinterpret_cast<void*>(index));
+            curl_multi_add_handle(multi, curl);
+            active++;
+        }
+    };
+
+    startPending();
+    while (active > 0) {
+        int running = 0;
+        curl_multi_perform(multi, &running);
+
+        CURLMsg* msg;
+        int left = 0;
+        while ((msg = curl_multi_info_read(multi, &left)) != nullptr) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            CURL* curl = msg->easy_handle;
+            void* priv = nullptr;
+            curl_easy_getinfo(curl, CURLINFO_PRIVATE, &priv);
+            size_t index = reinterpret_cast<size_t>(priv);
+
+            finishResult(curl, msg->data.result, &results[index]);
+            curl_multi_remove_handle(multi, curl);
+            releaseTransfer(transfers[index]);
+            active--;
+
+            onDone(index, results[index]);
+            // 回调之后就不再需要这份内容了
+            results[index] = DownloadResult();
+        }
+
+        startPending();
+        if (active > 0) {
+            curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+        }
+    }
+
+    curl_multi_cleanup(multi);
+}
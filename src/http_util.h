@@ -1,12 +1,48 @@
 #ifndef HTTP_UTIL_H
 #define HTTP_UTIL_H
 
+#include <functional>
 #include <string>
+#include <vector>
 
 //这不是类 只是存放一些普通函数的文件
 //通过libcurl(libcurl4-openssl-dev)库来对url里面的文本进行下载
 //只是用来下载订阅内容的...
+
+// 一次下载请求
+// etag和lastModified是上次下载时服务器给的 非空时会带上If-None-Match/If-Modified-Since
+struct DownloadRequest {
+    std::string url;
+    std::string etag;
+    std::string lastModified;
+
+    // 设置了onData时 响应内容边下载边交给它 不再攒进DownloadResult::body
+    // 返回false会中止这次传输 错误码的响应(4xx/5xx)不会交给它
+    std::function<bool(const char*, size_t)> onData;
+};
+
+// 一次下载的结果
+struct DownloadResult {
+    bool ok = false;           // 传输成功并且HTTP状态码不是错误码
+    bool notModified = false;  // 服务器返回304 内容和上次一样 此时body为空
+    long status = 0;           // HTTP状态码
+    std::string body;          // 响应内容 请求设置了onData时为空
+    std::string etag;          // 响应头里的ETag
+    std::string lastModified;  // 响应头里的Last-Modified
+    std::string error;         // 失败原因 成功时为空
+};
+
+// 下载单个url 失败时返回空字符串
 std::string downloadFromURL(const std::string& url);
 
-#endif
+// 带条件请求的下载 内容没变时只花一次往返 结果里notModified为true
+DownloadResult downloadFromURL(const DownloadRequest& request);
+
+// 用curl_multi并发下载一组url
+// 同时进行的传输最多maxConcurrency个 每完成一个就立刻调用一次onDone
+// onDone的第一个参数是这个请求在requests中的下标 回调里可以把body移走
+// 所有句柄共享DNS缓存 连接池和TLS会话(curl_share) 同一个机场的多个订阅只需要握手一次
+void downloadAll(const std::vector<DownloadRequest>& requests, int maxConcurrency,
+                 const std::function<void(size_t, DownloadResult&)>& onDone);
 
+#endif
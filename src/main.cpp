@@ -1,9 +1,17 @@
 #include <iostream>
+#include <string>
+#include <vector>
 #include "CLI.h"
 
-int main() {
+int main(int argc, char* argv[]) {
     try {
         CLI cli;
+        
+        // heresy search 关键词... 直接输出搜索结果 不进入菜单
+        if (argc > 1 && std::string(argv[1]) == "search") {
+            return cli.search(std::vector<std::string>(argv + 2, argv + argc));
+        }
+        
         cli.run();
     } catch (const std::exception& e) {
         std::cerr << "发生错误: " << e.what() << std::endl;
@@ -0,0 +1,24 @@
+#ifndef PROCESS_UTIL_H
+#define PROCESS_UTIL_H
+
+#include <string>
+#include <vector>
+
+//这不是类 只是存放一些普通函数的文件
+//不经过shell直接运行别的程序 参数原样传过去 不用操心引号和转义
+
+// 运行args[0]并等它结束 在PATH里找程序 标准输出和标准错误都丢掉
+// 返回程序的退出码 启动不了或者被信号杀掉时返回-1
+int runProgram(const std::vector<std::string>& args);
+
+#ifndef _WIN32
+// 在后台启动args[0] 不等它结束 返回pid 启动不了时返回-1
+// 放进单独的进程组 终端里按Ctrl-C不会连它一起杀掉 标准输出和标准错误都丢掉
+// 调用方负责用waitpid回收
+int spawnProgram(const std::vector<std::string>& args);
+
+// 本机的port端口能不能连上 用来判断子进程是不是已经开始监听
+bool localPortOpen(int port);
+#endif
+
+#endif
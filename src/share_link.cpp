@@ -0,0 +1,238 @@
+#include "share_link.h"
+#include <array>
+
+namespace {
+
+struct KnownKey {
+    std::string_view name;
+    QueryKey key;
+};
+
+// 各客户端常见的查询参数 包括同一个参数的不同写法
+constexpr KnownKey kKnownKeys[] = {
+    {"type", QueryKey::Type},
+    {"encryption", QueryKey::Encryption},
+    {"security", QueryKey::Security},
+    {"flow", QueryKey::Flow},
+    {"sni", QueryKey::Sni},
+    {"peer", QueryKey::Peer},
+    {"pbk", QueryKey::PublicKey},
+    {"publicKey", QueryKey::PublicKey},
+    {"sid", QueryKey::ShortId},
+    {"shortId", QueryKey::ShortId},
+    {"fp", QueryKey::Fingerprint},
+    {"fingerprint", QueryKey::Fingerprint},
+    {"spx", QueryKey::SpiderX},
+    {"host", QueryKey::Host},
+    {"path", QueryKey::Path},
+    {"alpn", QueryKey::Alpn},
+    {"headerType", QueryKey::HeaderType},
+    {"quicSecurity", QueryKey::QuicSecurity},
+    {"key", QueryKey::Key},
+    {"serviceName", QueryKey::ServiceName},
+    {"mode", QueryKey::Mode},
+    {"obfs", QueryKey::Obfs},
+    {"obfs-password", QueryKey::ObfsPassword},
+    {"insecure", QueryKey::Insecure},
+    {"allowInsecure", QueryKey::AllowInsecure},
+};
+
+constexpr size_t kKnownKeyCount = sizeof(kKnownKeys) / sizeof(kKnownKeys[0]);
+constexpr size_t kTableSize = 128;  // 2的幂 取模只要一次与运算
+
+constexpr uint32_t hashKey(std::string_view s, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (char c : s) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+constexpr bool isPerfectSeed(uint32_t seed) {
+    bool used[kTableSize] = {};
+    for (size_t i = 0; i < kKnownKeyCount; i++) {
+        uint32_t slot = hashKey(kKnownKeys[i].name, seed) & (kTableSize - 1);
+        if (used[slot]) {
+            return false;
+        }
+        used[slot] = true;
+    }
+    return true;
+}
+
+// 在编译期找一个让所有已知键都不冲突的种子
+constexpr uint32_t findSeed() {
+    for (uint32_t seed = 1; seed < 100000; seed++) {
+        if (isPerfectSeed(seed)) {
+            return seed;
+        }
+    }
+    return 0;
+}
+
+constexpr uint32_t kSeed = findSeed();
+static_assert(kSeed != 0, "找不到无冲突的哈希种子 请调大kTableSize");
+
+// 槽位 -> kKnownKeys的下标 空槽为-1
+constexpr std::array<int8_t, kTableSize> makeSlots() {
+    std::array<int8_t, kTableSize> slots{};
+    for (auto& slot : slots) {
+        slot = -1;
+    }
+    for (size_t i = 0; i < kKnownKeyCount; i++) {
+        slots[hashKey(kKnownKeys[i].name, kSeed) & (kTableSize - 1)] = static_cast<int8_t>(i);
+    }
+    return slots;
+}
+
+constexpr std::array<int8_t, kTableSize> kSlots = makeSlots();
+
+// 十六进制字符的值 不是十六进制字符时为-1
+constexpr std::array<int8_t, 256> makeHexTable() {
+    std::array<int8_t, 256> table{};
+    for (auto& value : table) {
+        value = -1;
+    }
+    for (int i = 0; i < 10; i++) {
+        table['0' + i] = static_cast<int8_t>(i);
+    }
+    for (int i = 0; i < 6; i++) {
+        table['a' + i] = static_cast<int8_t>(10 + i);
+        table['A' + i] = static_cast<int8_t>(10 + i);
+    }
+    return table;
+}
+
+constexpr std::array<int8_t, 256> kHexTable = makeHexTable();
+
+// 解析端口号 只接受1~65535的纯数字
+bool parsePort(std::string_view text, int& port) {
+    if (text.empty() || text.size() > 5) {
+        return false;
+    }
+    int value = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + (c - '0');
+    }
+    if (value <= 0 || value > 65535) {
+        return false;
+    }
+    port = value;
+    return true;
+}
+
+}  // namespace
+
+bool parseShareLink(std::string_view url, ShareLink& link) {
+    link = ShareLink();
+
+    size_t schemeEnd = url.find("://");
+    if (schemeEnd == std::string_view::npos || schemeEnd == 0) {
+        return false;
+    }
+    link.scheme = url.substr(0, schemeEnd);
+    std::string_view rest = url.substr(schemeEnd + 3);
+
+    // 先把#后面的别名切掉 别名里什么字符都可能有
+    size_t hash = rest.find('#');
+    if (hash != std::string_view::npos) {
+        link.fragment = rest.substr(hash + 1);
+        rest = rest.substr(0, hash);
+    }
+
+    size_t question = rest.find('?');
+    if (question != std::string_view::npos) {
+        link.query = rest.substr(question + 1);
+        rest = rest.substr(0, question);
+    }
+
+    // 剩下 userinfo@host:port[/path] 密码里可能有@ 以最后一个为准
+    size_t at = rest.rfind('@');
+    if (at == std::string_view::npos || at == 0) {
+        return false;
+    }
+    link.userinfo = rest.substr(0, at);
+    std::string_view hostPort = rest.substr(at + 1);
+
+    size_t slash = hostPort.find('/');
+    if (slash != std::string_view::npos) {
+        hostPort = hostPort.substr(0, slash);
+    }
+
+    std::string_view portText;
+    if (!hostPort.empty() && hostPort.front() == '[') {
+        // IPv6: [2001:db8::1]:443
+        size_t close = hostPort.find(']');
+        if (close == std::string_view::npos || close + 1 >= hostPort.size() || hostPort[close + 1] != ':') {
+            return false;
+        }
+        link.host = hostPort.substr(1, close - 1);
+        portText = hostPort.substr(close + 2);
+    } else {
+        size_t colon = hostPort.rfind(':');
+        if (colon == std::string_view::npos) {
+            return false;
+        }
+        link.host = hostPort.substr(0, colon);
+        portText = hostPort.substr(colon + 1);
+    }
+
+    if (link.host.empty()) {
+        return false;
+    }
+    return parsePort(portText, link.port);
+}
+
+bool schemeIs(const ShareLink& link, std::string_view expected) {
+    if (link.scheme.size() != expected.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < expected.size(); i++) {
+        char c = link.scheme[i];
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+        if (c != expected[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QueryKey lookupQueryKey(std::string_view name) {
+    int8_t index = kSlots[hashKey(name, kSeed) & (kTableSize - 1)];
+    if (index >= 0 && kKnownKeys[index].name == name) {
+        return kKnownKeys[index].key;
+    }
+    return QueryKey::Unknown;
+}
+
+std::string percentDecode(std::string_view encoded) {
+    std::string result;
+    result.reserve(encoded.size());
+
+    size_t len = encoded.size();
+    for (size_t i = 0; i < len; i++) {
+        char c = encoded[i];
+        if (c == '%' && i + 2 < len) {
+            int high = kHexTable[static_cast<unsigned char>(encoded[i + 1])];
+            int low = kHexTable[static_cast<unsigned char>(encoded[i + 2])];
+            if (high >= 0 && low >= 0) {
+                result.push_back(static_cast<char>((high << 4) | low));
+                i += 2;
+                continue;
+            }
+            result.push_back(c);
+        } else if (c == '+') {
+            result.push_back(' ');
+        } else {
+            result.push_back(c);
+        }
+    }
+
+    return result;
+}
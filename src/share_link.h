@@ -0,0 +1,79 @@
+#ifndef SHARE_LINK_H
+#define SHARE_LINK_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+//这不是类 只是存放分享链接解析函数的文件
+//vless trojan hysteria2这类 scheme://userinfo@host:port?query#fragment 格式的链接共用这一套
+//解析结果全部是指向原字符串的string_view 不做任何复制 需要时再按字段解码
+
+// 分享链接的各个部分 都还没有做百分号解码
+struct ShareLink {
+    std::string_view scheme;    // 协议 如vless
+    std::string_view userinfo;  // @前面的部分 uuid或密码
+    std::string_view host;      // 地址 IPv6地址已经去掉了两边的方括号
+    int port = 0;               // 端口
+    std::string_view query;     // ?和#之间的查询参数
+    std::string_view fragment;  // #后面的部分 一般是节点别名
+};
+
+// 把链接拆成各个部分 格式不对(没有@ 没有端口 端口不合法等)时返回false
+bool parseShareLink(std::string_view url, ShareLink& link);
+
+// scheme不区分大小写 expected要求是小写
+bool schemeIs(const ShareLink& link, std::string_view expected);
+
+// 查询参数里已知的键 别名会归到同一个值上(比如pbk和publicKey)
+enum class QueryKey : uint8_t {
+    Unknown,
+    Type,
+    Encryption,
+    Security,
+    Flow,
+    Sni,
+    Peer,
+    PublicKey,
+    ShortId,
+    Fingerprint,
+    SpiderX,
+    Host,
+    Path,
+    Alpn,
+    HeaderType,
+    QuicSecurity,
+    Key,
+    ServiceName,
+    Mode,
+    Obfs,
+    ObfsPassword,
+    Insecure,
+    AllowInsecure,
+};
+
+// 查找键对应的QueryKey 用编译期生成的完美哈希表 一次哈希加一次比较
+QueryKey lookupQueryKey(std::string_view name);
+
+// 依次处理查询参数 对每个 键=值 调用 fn(QueryKey, 键, 未解码的值)
+// 没有等号的参数和空键会被跳过
+template <typename Fn>
+void forEachQueryParam(std::string_view query, Fn&& fn) {
+    while (!query.empty()) {
+        size_t amp = query.find('&');
+        std::string_view param = query.substr(0, amp);
+        query = amp == std::string_view::npos ? std::string_view() : query.substr(amp + 1);
+
+        size_t eq = param.find('=');
+        if (eq == std::string_view::npos || eq == 0) {
+            continue;
+        }
+        std::string_view name = param.substr(0, eq);
+        fn(lookupQueryKey(name), name, param.substr(eq + 1));
+    }
+}
+
+// 百分号解码 查表实现 '+'会变成空格 不合法的%序列原样保留
+std::string percentDecode(std::string_view encoded);
+
+#endif
@@ -0,0 +1,86 @@
+#include "stream_util.h"
+
+bool Base64StreamDecoder::feed(const char* data, size_t len, std::string& out) {
+    if (error) {
+        return false;
+    }
+    if (!base64_decode_append(data, len, state, out)) {
+        error = true;
+        return false;
+    }
+    return true;
+}
+
+bool Base64StreamDecoder::finish(std::string& out) {
+    if (error) {
+        return false;
+    }
+    base64_decode_finish(state, out);
+    return true;
+}
+
+bool Base64StreamDecoder::failed() const {
+    return error;
+}
+
+LineSplitter::LineSplitter(size_t maxLineLength) : maxLineLength(maxLineLength) {}
+
+void LineSplitter::feed(std::string_view data, const std::function<void(std::string_view)>& onLine) {
+    while (!data.empty()) {
+        size_t newline = data.find('\n');
+        if (newline == std::string_view::npos) {
+            // 没有换行 整块都属于还没结束的这一行
+            if (!overflow) {
+                if (pending.size() + data.size() > maxLineLength) {
+                    overflow = true;
+                    pending.clear();
+                } else {
+                    pending.append(data.data(), data.size());
+                }
+            }
+            return;
+        }
+
+        std::string_view head = data.substr(0, newline);
+        data.remove_prefix(newline + 1);
+
+        if (overflow) {
+            overflow = false;
+            dropped++;
+            continue;
+        }
+
+        if (pending.empty()) {
+            // 整行都在这一块里 不用复制
+            emit(head, onLine);
+        } else if (pending.size() + head.size() > maxLineLength) {
+            pending.clear();
+            dropped++;
+        } else {
+            pending.append(head.data(), head.size());
+            emit(pending, onLine);
+            pending.clear();
+        }
+    }
+}
+
+void LineSplitter::finish(const std::function<void(std::string_view)>& onLine) {
+    if (overflow) {
+        overflow = false;
+        dropped++;
+    } else if (!pending.empty()) {
+        emit(pending, onLine);
+    }
+    pending.clear();
+}
+
+size_t LineSplitter::droppedLines() const {
+    return dropped;
+}
+
+void LineSplitter::emit(std::string_view line, const std::function<void(std::string_view)>& onLine) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    onLine(line);
+}
@@ -0,0 +1,58 @@
+#ifndef STREAM_UTIL_H
+#define STREAM_UTIL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include "base64.h"
+
+// 增量base64解码器
+// 数据可以按任意大小分块喂进来 不需要先把整个订阅攒成一个字符串
+// 同时接受标准和url安全两套字符 跳过空白和换行 缺少的填充也能处理
+// 遇到非法字符时不抛异常 feed返回false 之后failed()一直为true
+// 解码本身由base64_decode_append完成 支持的CPU上会走SIMD
+class Base64StreamDecoder {
+   public:
+    // 解码一块数据 结果追加到out
+    bool feed(const char* data, size_t len, std::string& out);
+
+    // 输入结束 把最后不满4个字符的部分解出来
+    bool finish(std::string& out);
+
+    bool failed() const;
+
+   private:
+    base64_decode_state state;  // 还没凑满4个字符的部分
+    bool error = false;
+};
+
+// 行切分器
+// 把任意切开的数据块重新拼成完整的行 只有不完整的最后一行会被暂存
+// 去掉行尾的\r 超过maxLineLength的行会被整行丢弃 防止异常数据把内存撑爆
+class LineSplitter {
+   public:
+    static const size_t kDefaultMaxLineLength = 64 * 1024;
+
+    explicit LineSplitter(size_t maxLineLength = kDefaultMaxLineLength);
+
+    // 每拼出一个完整的行就调用一次onLine
+    void feed(std::string_view data, const std::function<void(std::string_view)>& onLine);
+
+    // 输入结束 把最后一行(没有换行符结尾)交出去
+    void finish(const std::function<void(std::string_view)>& onLine);
+
+    // 因为太长被丢弃的行数
+    size_t droppedLines() const;
+
+   private:
+    std::string pending;     // 不完整的行
+    size_t maxLineLength;
+    bool overflow = false;   // 当前行已经超长 丢弃到下一个换行为止
+    size_t dropped = 0;
+
+    void emit(std::string_view line, const std::function<void(std::string_view)>& onLine);
+};
+
+#endif